@@ -0,0 +1,104 @@
+﻿#include "AudioBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+AudioBuffer::AudioBuffer()
+    : read_offset{},
+      write_offset{},
+      read_position{},
+      write_position{},
+      bytes_per_second{},
+      block_size{1}
+{
+}
+
+void AudioBuffer::Reset(const int bytes_per_second, const int block_size, const size_t capacity)
+{
+    Clear();
+    this->bytes_per_second = bytes_per_second;
+    this->block_size = block_size > 0 ? block_size : 1;
+    buffer.resize(capacity);
+}
+
+void AudioBuffer::Clear()
+{
+    markers.clear();
+    read_offset = 0;
+    write_offset = 0;
+
+    // Positions keep counting up, so that markers never need to be rebased
+    read_position = write_position;
+}
+
+uint8_t* AudioBuffer::BeginWrite(const size_t size)
+{
+    if (buffer.size() - write_offset >= size)
+    {
+        return buffer.data() + write_offset;
+    }
+
+    // Move the unread audio back to the start of the buffer; this only happens once per buffer's worth of audio
+    const auto buffered = write_offset - read_offset;
+    if (read_offset > 0)
+    {
+        memmove(buffer.data(), buffer.data() + read_offset, buffered);
+        read_offset = 0;
+        write_offset = buffered;
+    }
+
+    if (buffer.size() - write_offset < size)
+    {
+        buffer.resize(write_offset + size);
+    }
+
+    return buffer.data() + write_offset;
+}
+
+void AudioBuffer::EndWrite(const size_t size, const double pts)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    markers.push_back(Marker{write_position, pts});
+    write_offset += size;
+    write_position += static_cast<int64_t>(size);
+}
+
+size_t AudioBuffer::Read(uint8_t* dst, const size_t size, double& pts)
+{
+    const auto to_read = std::min(size, Size()) / block_size * block_size;
+    if (to_read == 0)
+    {
+        return 0;
+    }
+
+    // Drop markers for audio that has already been read past
+    while (markers.size() > 1 && markers[1].position <= read_position)
+    {
+        markers.pop_front();
+    }
+
+    const auto& marker = markers.front();
+    pts = marker.pts + static_cast<double>(read_position - marker.position) / bytes_per_second;
+
+    memcpy(dst, buffer.data() + read_offset, to_read);
+    read_offset += to_read;
+    read_position += static_cast<int64_t>(to_read);
+
+    if (read_offset == write_offset)
+    {
+        // Start over from the front whenever the buffer runs empty, so it rarely needs compacting
+        read_offset = 0;
+        write_offset = 0;
+    }
+
+    return to_read;
+}
+
+size_t AudioBuffer::Size() const
+{
+    return write_offset - read_offset;
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/**
+ * \brief A buffer of decoded, resampled audio that the reader fills ahead of playback and reads out of with plain
+ * copies. Decoders write straight into its free space, and every write is tagged with the timestamp of its first
+ * sample, so the timestamp of any byte that is read can be derived exactly. This is a linear buffer rather than a
+ * ring: unread audio is moved back to the start when a write needs contiguous space at the end.
+ */
+class AudioBuffer
+{
+public:
+    AudioBuffer();
+
+    AudioBuffer(const AudioBuffer&) = delete;
+    AudioBuffer& operator=(const AudioBuffer&) = delete;
+
+    /**
+     * \brief Discards all buffered audio and sets up the buffer for a new output format.
+     * \param bytes_per_second The number of bytes in one second of output audio.
+     * \param block_size The size of one sample across all channels, in bytes.
+     * \param capacity The number of bytes to reserve up front. The buffer grows beyond this if needed.
+     */
+    void Reset(int bytes_per_second, int block_size, size_t capacity);
+
+    /**
+     * \brief Discards all buffered audio, keeping the current format.
+     */
+    void Clear();
+
+    /**
+     * \brief Gets contiguous free space to write audio into, moving or growing the buffer if needed.
+     * \param size The number of bytes that will be written at most.
+     * \return A pointer to the free space, which stays valid until the next call to any other method.
+     */
+    uint8_t* BeginWrite(size_t size);
+
+    /**
+     * \brief Commits audio written into the space returned by BeginWrite().
+     * \param size The number of bytes that were written.
+     * \param pts The timestamp of the first written sample, in seconds.
+     */
+    void EndWrite(size_t size, double pts);
+
+    /**
+     * \brief Copies buffered audio out of the buffer.
+     * \param dst The buffer to copy audio into.
+     * \param size The maximum number of bytes to copy. This is rounded down to whole samples.
+     * \param pts The timestamp of the first copied sample, in seconds. This is only set if anything was copied.
+     * \return The number of bytes that were copied.
+     */
+    size_t Read(uint8_t* dst, size_t size, double& pts);
+
+    /**
+     * \brief Gets the number of buffered bytes.
+     */
+    size_t Size() const;
+
+private:
+    // The timestamp of the audio starting at some byte position
+    struct Marker
+    {
+        int64_t position;
+        double pts;
+    };
+
+    std::vector<uint8_t> buffer;
+    std::deque<Marker> markers;
+    size_t read_offset;
+    size_t write_offset;
+    int64_t read_position;
+    int64_t write_position;
+    int bytes_per_second;
+    int block_size;
+};
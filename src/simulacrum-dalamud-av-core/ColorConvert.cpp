@@ -0,0 +1,446 @@
+﻿#include "ColorConvert.h"
+
+#include <cmath>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/*
+ * The converters work in 16-bit fixed point, in the same way on every instruction set so that they
+ * produce identical output. Each input is centered and shifted left by 6 bits, and then multiplied
+ * by a coefficient with 13 fractional bits using a rounding high multiply (pmulhrsw), leaving a term
+ * with 4 fractional bits. The terms for each channel are summed, rounded, and saturated to 8 bits.
+ */
+
+enum class ColorConvertIsa
+{
+    none,
+    sse41,
+    avx2,
+};
+
+struct YuvCoefficients
+{
+    int16_t y_offset;
+    int16_t y;
+    int16_t v_r;
+    int16_t u_g;
+    int16_t v_g;
+    int16_t u_b;
+};
+
+struct Plane
+{
+    const uint8_t* y;
+    const uint8_t* u;
+    const uint8_t* v;
+    int interleaved;
+};
+
+static ColorConvertIsa detect_isa()
+{
+    int info[4]{};
+#ifdef _MSC_VER
+    __cpuid(info, 0);
+    const auto max_leaf = info[0];
+    __cpuid(info, 1);
+#else
+    const auto max_leaf = static_cast<int>(__get_cpuid_max(0, nullptr));
+    __cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+    const auto has_sse41 = (info[2] & 1 << 19) != 0;
+    const auto has_osxsave = (info[2] & 1 << 27) != 0;
+    const auto has_avx = (info[2] & 1 << 28) != 0;
+    if (!has_sse41)
+    {
+        return ColorConvertIsa::none;
+    }
+
+    // AVX2 also needs the OS to save the upper halves of the vector registers
+    if (max_leaf >= 7 && has_osxsave && has_avx)
+    {
+#ifdef _MSC_VER
+        const auto xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+#else
+        uint32_t xcr0_lo, xcr0_hi;
+        __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        const auto xcr0 = static_cast<uint64_t>(xcr0_hi) << 32 | xcr0_lo;
+        __cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+#endif
+        if ((xcr0 & 6) == 6 && (info[1] & 1 << 5) != 0)
+        {
+            return ColorConvertIsa::avx2;
+        }
+    }
+
+    return ColorConvertIsa::sse41;
+}
+
+static ColorConvertIsa get_isa()
+{
+    static const auto isa = detect_isa();
+    return isa;
+}
+
+static int16_t to_fixed(const double coefficient)
+{
+    return static_cast<int16_t>(std::lround(coefficient * 8192));
+}
+
+static YuvCoefficients make_coefficients(const double kr, const double kb, const bool full_range)
+{
+    const auto kg = 1 - kr - kb;
+    const auto y_scale = full_range ? 1.0 : 255.0 / 219.0;
+    const auto c_scale = full_range ? 1.0 : 255.0 / 224.0;
+    return YuvCoefficients{
+        static_cast<int16_t>(full_range ? 0 : 16),
+        to_fixed(y_scale),
+        to_fixed(2 * (1 - kr) * c_scale),
+        to_fixed(2 * kb * (1 - kb) / kg * c_scale),
+        to_fixed(2 * kr * (1 - kr) / kg * c_scale),
+        to_fixed(2 * (1 - kb) * c_scale),
+    };
+}
+
+static const YuvCoefficients* get_coefficients(const AVFrame* frame)
+{
+    static const YuvCoefficients bt601_limited = make_coefficients(0.299, 0.114, false);
+    static const YuvCoefficients bt601_full = make_coefficients(0.299, 0.114, true);
+    static const YuvCoefficients bt709_limited = make_coefficients(0.2126, 0.0722, false);
+    static const YuvCoefficients bt709_full = make_coefficients(0.2126, 0.0722, true);
+
+    const auto full_range = ResolveColorRange(frame->color_range, frame->format) == AVCOL_RANGE_JPEG;
+    switch (ResolveColorSpace(frame->colorspace, frame->height))
+    {
+    case AVCOL_SPC_BT709:
+        return full_range ? &bt709_full : &bt709_limited;
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+        return full_range ? &bt601_full : &bt601_limited;
+    default:
+        return nullptr;
+    }
+}
+
+static int fixed_term(const int value, const int16_t coefficient)
+{
+    return ((value << 6) * coefficient + 0x4000) >> 15;
+}
+
+static uint8_t fixed_to_channel(const int value)
+{
+    const auto channel = (value + 8) >> 4;
+    return static_cast<uint8_t>(channel < 0 ? 0 : channel > 255 ? 255 : channel);
+}
+
+static void convert_row_scalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, const int chroma_step,
+                               uint8_t* dst, const int x_start, const int width, const YuvCoefficients& c)
+{
+    for (auto x = x_start; x < width; x++)
+    {
+        const auto u_value = u[x / 2 * chroma_step] - 128;
+        const auto v_value = v[x / 2 * chroma_step] - 128;
+        const auto luma = fixed_term(y[x] - c.y_offset, c.y);
+        dst[x * 4 + 0] = fixed_to_channel(luma + fixed_term(u_value, c.u_b));
+        dst[x * 4 + 1] = fixed_to_channel(luma - (fixed_term(u_value, c.u_g) + fixed_term(v_value, c.v_g)));
+        dst[x * 4 + 2] = fixed_to_channel(luma + fixed_term(v_value, c.v_r));
+        dst[x * 4 + 3] = 0xFF;
+    }
+}
+
+struct Sse41Coefficients
+{
+    __m128i y_offset, y, v_r, u_g, v_g, u_b, chroma_offset, round, alpha;
+};
+
+TARGET_SSE41 static Sse41Coefficients load_sse41_coefficients(const YuvCoefficients& c)
+{
+    return Sse41Coefficients{
+        _mm_set1_epi16(c.y_offset), _mm_set1_epi16(c.y), _mm_set1_epi16(c.v_r), _mm_set1_epi16(c.u_g),
+        _mm_set1_epi16(c.v_g), _mm_set1_epi16(c.u_b), _mm_set1_epi16(128), _mm_set1_epi16(8),
+        _mm_set1_epi8(static_cast<char>(0xFF)),
+    };
+}
+
+// Writes 16 BGRA pixels from 16 luma values and the matching (already duplicated) chroma terms
+TARGET_SSE41 static void store_sse41(const __m128i y_bytes, const __m128i r_lo, const __m128i r_hi,
+                                     const __m128i g_lo, const __m128i g_hi, const __m128i b_lo,
+                                     const __m128i b_hi, uint8_t* dst, const Sse41Coefficients& c)
+{
+    const auto y_lo = _mm_mulhrs_epi16(_mm_slli_epi16(_mm_sub_epi16(_mm_cvtepu8_epi16(y_bytes), c.y_offset), 6), c.y);
+    const auto y_hi = _mm_mulhrs_epi16(
+        _mm_slli_epi16(_mm_sub_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(y_bytes, 8)), c.y_offset), 6), c.y);
+
+    const auto r = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y_lo, r_lo), c.round), 4),
+                                    _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y_hi, r_hi), c.round), 4));
+    const auto g = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(y_lo, g_lo), c.round), 4),
+                                    _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(y_hi, g_hi), c.round), 4));
+    const auto b = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y_lo, b_lo), c.round), 4),
+                                    _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(y_hi, b_hi), c.round), 4));
+
+    const auto bg_lo = _mm_unpacklo_epi8(b, g);
+    const auto bg_hi = _mm_unpackhi_epi8(b, g);
+    const auto ra_lo = _mm_unpacklo_epi8(r, c.alpha);
+    const auto ra_hi = _mm_unpackhi_epi8(r, c.alpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(bg_lo, ra_lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(bg_lo, ra_lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), _mm_unpacklo_epi16(bg_hi, ra_hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 48), _mm_unpackhi_epi16(bg_hi, ra_hi));
+}
+
+TARGET_SSE41 static void convert_rows_sse41(const uint8_t* y0, const uint8_t* y1, const Plane& chroma,
+                                            uint8_t* dst0, uint8_t* dst1, const int width,
+                                            const YuvCoefficients& coefficients)
+{
+    const auto c = load_sse41_coefficients(coefficients);
+    const auto chroma_mask = _mm_set1_epi16(0x00FF);
+
+    auto x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        // Load the 8 chroma samples covering these 16 pixels
+        __m128i u, v;
+        if (chroma.interleaved)
+        {
+            const auto uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chroma.u + x));
+            u = _mm_and_si128(uv, chroma_mask);
+            v = _mm_srli_epi16(uv, 8);
+        }
+        else
+        {
+            u = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(chroma.u + x / 2)));
+            v = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(chroma.v + x / 2)));
+        }
+
+        u = _mm_slli_epi16(_mm_sub_epi16(u, c.chroma_offset), 6);
+        v = _mm_slli_epi16(_mm_sub_epi16(v, c.chroma_offset), 6);
+
+        // The chroma terms are shared by both rows and by each pair of horizontal pixels
+        const auto r = _mm_mulhrs_epi16(v, c.v_r);
+        const auto g = _mm_add_epi16(_mm_mulhrs_epi16(u, c.u_g), _mm_mulhrs_epi16(v, c.v_g));
+        const auto b = _mm_mulhrs_epi16(u, c.u_b);
+        const auto r_lo = _mm_unpacklo_epi16(r, r), r_hi = _mm_unpackhi_epi16(r, r);
+        const auto g_lo = _mm_unpacklo_epi16(g, g), g_hi = _mm_unpackhi_epi16(g, g);
+        const auto b_lo = _mm_unpacklo_epi16(b, b), b_hi = _mm_unpackhi_epi16(b, b);
+
+        store_sse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y0 + x)), r_lo, r_hi, g_lo, g_hi, b_lo, b_hi,
+                    dst0 + x * 4, c);
+        if (y1)
+        {
+            store_sse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y1 + x)), r_lo, r_hi, g_lo, g_hi, b_lo,
+                        b_hi, dst1 + x * 4, c);
+        }
+    }
+
+    const auto chroma_step = chroma.interleaved ? 2 : 1;
+    convert_row_scalar(y0, chroma.u, chroma.v, chroma_step, dst0, x, width, coefficients);
+    if (y1)
+    {
+        convert_row_scalar(y1, chroma.u, chroma.v, chroma_step, dst1, x, width, coefficients);
+    }
+}
+
+struct Avx2Coefficients
+{
+    __m256i y_offset, y, v_r, u_g, v_g, u_b, chroma_offset, round, alpha;
+};
+
+TARGET_AVX2 static Avx2Coefficients load_avx2_coefficients(const YuvCoefficients& c)
+{
+    return Avx2Coefficients{
+        _mm256_set1_epi16(c.y_offset), _mm256_set1_epi16(c.y), _mm256_set1_epi16(c.v_r), _mm256_set1_epi16(c.u_g),
+        _mm256_set1_epi16(c.v_g), _mm256_set1_epi16(c.u_b), _mm256_set1_epi16(128), _mm256_set1_epi16(8),
+        _mm256_set1_epi8(static_cast<char>(0xFF)),
+    };
+}
+
+// Writes 32 BGRA pixels from 32 luma values and the matching (already duplicated) chroma terms
+TARGET_AVX2 static void store_avx2(const __m256i y_bytes, const __m256i r_lo, const __m256i r_hi,
+                                   const __m256i g_lo, const __m256i g_hi, const __m256i b_lo,
+                                   const __m256i b_hi, uint8_t* dst, const Avx2Coefficients& c)
+{
+    const auto y_lo = _mm256_mulhrs_epi16(
+        _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(y_bytes)), c.y_offset), 6),
+        c.y);
+    const auto y_hi = _mm256_mulhrs_epi16(
+        _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(y_bytes, 1)), c.y_offset),
+                          6), c.y);
+
+    // Packing works within each 128-bit lane, so these hold pixels 0-7 and 16-23, then 8-15 and 24-31
+    const auto r = _mm256_packus_epi16(
+        _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y_lo, r_lo), c.round), 4),
+        _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y_hi, r_hi), c.round), 4));
+    const auto g = _mm256_packus_epi16(
+        _mm256_srai_epi16(_mm256_add_epi16(_mm256_sub_epi16(y_lo, g_lo), c.round), 4),
+        _mm256_srai_epi16(_mm256_add_epi16(_mm256_sub_epi16(y_hi, g_hi), c.round), 4));
+    const auto b = _mm256_packus_epi16(
+        _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y_lo, b_lo), c.round), 4),
+        _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(y_hi, b_hi), c.round), 4));
+
+    // Interleaving keeps the same lane layout: pixels 0-7 | 8-15 in the low halves, 16-23 | 24-31 in the high ones
+    const auto bg_lo = _mm256_unpacklo_epi8(b, g);
+    const auto bg_hi = _mm256_unpackhi_epi8(b, g);
+    const auto ra_lo = _mm256_unpacklo_epi8(r, c.alpha);
+    const auto ra_hi = _mm256_unpackhi_epi8(r, c.alpha);
+    const auto p0 = _mm256_unpacklo_epi16(bg_lo, ra_lo); // 0-3 | 8-11
+    const auto p1 = _mm256_unpackhi_epi16(bg_lo, ra_lo); // 4-7 | 12-15
+    const auto p2 = _mm256_unpacklo_epi16(bg_hi, ra_hi); // 16-19 | 24-27
+    const auto p3 = _mm256_unpackhi_epi16(bg_hi, ra_hi); // 20-23 | 28-31
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 64), _mm256_permute2x128_si256(p2, p3, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+}
+
+TARGET_AVX2 static void convert_rows_avx2(const uint8_t* y0, const uint8_t* y1, const Plane& chroma,
+                                          uint8_t* dst0, uint8_t* dst1, const int width,
+                                          const YuvCoefficients& coefficients)
+{
+    const auto c = load_avx2_coefficients(coefficients);
+    const auto chroma_mask = _mm256_set1_epi16(0x00FF);
+
+    auto x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+        // Load the 16 chroma samples covering these 32 pixels
+        __m256i u, v;
+        if (chroma.interleaved)
+        {
+            const auto uv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chroma.u + x));
+            u = _mm256_and_si256(uv, chroma_mask);
+            v = _mm256_srli_epi16(uv, 8);
+        }
+        else
+        {
+            u = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chroma.u + x / 2)));
+            v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chroma.v + x / 2)));
+        }
+
+        u = _mm256_slli_epi16(_mm256_sub_epi16(u, c.chroma_offset), 6);
+        v = _mm256_slli_epi16(_mm256_sub_epi16(v, c.chroma_offset), 6);
+
+        // Reorder samples 0-3, 8-11 | 4-7, 12-15, so that duplicating within lanes lines up with pixels 0-15
+        // (the low halves) and 16-31 (the high halves)
+        const auto r = _mm256_permute4x64_epi64(_mm256_mulhrs_epi16(v, c.v_r), 0xD8);
+        const auto g = _mm256_permute4x64_epi64(
+            _mm256_add_epi16(_mm256_mulhrs_epi16(u, c.u_g), _mm256_mulhrs_epi16(v, c.v_g)), 0xD8);
+        const auto b = _mm256_permute4x64_epi64(_mm256_mulhrs_epi16(u, c.u_b), 0xD8);
+        const auto r_lo = _mm256_unpacklo_epi16(r, r), r_hi = _mm256_unpackhi_epi16(r, r);
+        const auto g_lo = _mm256_unpacklo_epi16(g, g), g_hi = _mm256_unpackhi_epi16(g, g);
+        const auto b_lo = _mm256_unpacklo_epi16(b, b), b_hi = _mm256_unpackhi_epi16(b, b);
+
+        store_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y0 + x)), r_lo, r_hi, g_lo, g_hi, b_lo, b_hi,
+                   dst0 + x * 4, c);
+        if (y1)
+        {
+            store_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y1 + x)), r_lo, r_hi, g_lo, g_hi, b_lo,
+                       b_hi, dst1 + x * 4, c);
+        }
+    }
+
+    const auto chroma_step = chroma.interleaved ? 2 : 1;
+    convert_row_scalar(y0, chroma.u, chroma.v, chroma_step, dst0, x, width, coefficients);
+    if (y1)
+    {
+        convert_row_scalar(y1, chroma.u, chroma.v, chroma_step, dst1, x, width, coefficients);
+    }
+}
+
+AVColorSpace ResolveColorSpace(const AVColorSpace color_space, const int height)
+{
+    if (color_space != AVCOL_SPC_UNSPECIFIED)
+    {
+        return color_space;
+    }
+
+    return height >= 720 ? AVCOL_SPC_BT709 : AVCOL_SPC_BT470BG;
+}
+
+AVColorRange ResolveColorRange(const AVColorRange color_range, const int format)
+{
+    if (color_range != AVCOL_RANGE_UNSPECIFIED)
+    {
+        return color_range;
+    }
+
+    // The deprecated JPEG formats are full range by definition
+    switch (format)
+    {
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_YUVJ422P:
+    case AV_PIX_FMT_YUVJ444P:
+    case AV_PIX_FMT_YUVJ440P:
+    case AV_PIX_FMT_YUVJ411P:
+        return AVCOL_RANGE_JPEG;
+    default:
+        return AVCOL_RANGE_MPEG;
+    }
+}
+
+bool CanConvertToBgra(const AVFrame* frame)
+{
+    if (get_isa() == ColorConvertIsa::none)
+    {
+        return false;
+    }
+
+    if (frame->format != AV_PIX_FMT_YUV420P && frame->format != AV_PIX_FMT_YUVJ420P &&
+        frame->format != AV_PIX_FMT_NV12)
+    {
+        return false;
+    }
+
+    return get_coefficients(frame) != nullptr;
+}
+
+void ConvertToBgra(const AVFrame* frame, uint8_t* dst, const int stride, const int row_start, const int row_count)
+{
+    const auto& coefficients = *get_coefficients(frame);
+    const auto interleaved = frame->format == AV_PIX_FMT_NV12;
+    const auto convert_rows = get_isa() == ColorConvertIsa::avx2 ? convert_rows_avx2 : convert_rows_sse41;
+
+    const auto row_end = row_start + row_count;
+    for (auto row = row_start; row < row_end;)
+    {
+        // Rows are converted in pairs where possible, since both rows of a pair share the same chroma row
+        const auto paired = row % 2 == 0 && row + 1 < row_end;
+        const auto chroma_row = row / 2;
+
+        Plane chroma{};
+        chroma.interleaved = interleaved;
+        chroma.u = frame->data[1] + static_cast<ptrdiff_t>(chroma_row) * frame->linesize[1];
+        chroma.v = interleaved
+                       ? chroma.u + 1
+                       : frame->data[2] + static_cast<ptrdiff_t>(chroma_row) * frame->linesize[2];
+
+        const auto* y0 = frame->data[0] + static_cast<ptrdiff_t>(row) * frame->linesize[0];
+        const auto* y1 = paired ? y0 + frame->linesize[0] : nullptr;
+        auto* dst0 = dst + static_cast<ptrdiff_t>(row) * stride;
+        auto* dst1 = paired ? dst0 + stride : nullptr;
+        convert_rows(y0, y1, chroma, dst0, dst1, frame->width, coefficients);
+
+        row += paired ? 2 : 1;
+    }
+}
+
+const char* GetColorConvertIsa()
+{
+    switch (get_isa())
+    {
+    case ColorConvertIsa::avx2:
+        return "avx2";
+    case ColorConvertIsa::sse41:
+        return "sse4.1";
+    default:
+        return "none";
+    }
+}
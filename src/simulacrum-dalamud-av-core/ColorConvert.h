@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+/**
+ * \brief Resolves the color space of a frame that may not specify one. Every conversion path uses this, so
+ * that frames without color metadata look the same no matter how they are converted. Unspecified frames are
+ * treated as BT.709 if they are HD, and as BT.601 otherwise.
+ * \param color_space The color space the frame specifies.
+ * \param height The height of the frame, in pixels.
+ * \return The color space to convert the frame with.
+ */
+AVColorSpace ResolveColorSpace(AVColorSpace color_space, int height);
+
+/**
+ * \brief Resolves the color range of a frame that may not specify one. Unspecified frames are treated as
+ * limited range, unless their pixel format implies full range.
+ * \param color_range The color range the frame specifies.
+ * \param format The pixel format of the frame.
+ * \return The color range to convert the frame with.
+ */
+AVColorRange ResolveColorRange(AVColorRange color_range, int format);
+
+/**
+ * \brief Checks if a frame can be converted to BGRA by the built-in SIMD color converters. These handle
+ * YUV420P and NV12 frames with BT.601 or BT.709 colors in either range, on CPUs with SSE4.1 or AVX2.
+ * \param frame The frame to check.
+ * \return `true` if the frame can be converted; otherwise `false`.
+ */
+bool CanConvertToBgra(const AVFrame* frame);
+
+/**
+ * \brief Converts rows of a frame to BGRA at its original size. Exactly width * 4 bytes are written per row.
+ * The frame must have been accepted by CanConvertToBgra().
+ * \param frame The frame to convert.
+ * \param dst The output buffer. Row 0 of the frame corresponds to the start of this buffer.
+ * \param stride The distance between the starts of consecutive rows in the output buffer, in bytes.
+ * \param row_start The first row to convert.
+ * \param row_count The number of rows to convert.
+ */
+void ConvertToBgra(const AVFrame* frame, uint8_t* dst, int stride, int row_start, int row_count);
+
+/**
+ * \brief Gets the name of the instruction set the SIMD color converters use on this CPU.
+ * \return "avx2", "sse4.1", or "none".
+ */
+const char* GetColorConvertIsa();
@@ -0,0 +1,91 @@
+﻿#include "FrameQueue.h"
+
+FrameQueue::FrameQueue(const size_t capacity)
+    : read_index{},
+      count{},
+      serial{},
+      wake_pending{}
+{
+    frames.resize(capacity);
+    for (auto& frame : frames)
+    {
+        frame = av_frame_alloc();
+    }
+}
+
+FrameQueue::~FrameQueue()
+{
+    for (auto& frame : frames)
+    {
+        av_frame_free(&frame);
+    }
+}
+
+bool FrameQueue::WaitForSpace()
+{
+    std::unique_lock lock(mtx);
+    can_push.wait(lock, [this] { return count < frames.size() || wake_pending; });
+    wake_pending = false;
+    return count < frames.size();
+}
+
+void FrameQueue::Push(AVFrame* frame)
+{
+    const std::unique_lock lock(mtx);
+    auto* slot = frames[(read_index + count) % frames.size()];
+    av_frame_move_ref(slot, frame);
+    count++;
+}
+
+bool FrameQueue::Pop(AVFrame* frame, int& serial)
+{
+    {
+        const std::unique_lock lock(mtx);
+        if (count == 0)
+        {
+            return false;
+        }
+
+        auto* slot = frames[read_index];
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, slot);
+        read_index = (read_index + 1) % frames.size();
+        count--;
+        serial = this->serial;
+    }
+
+    can_push.notify_one();
+    return true;
+}
+
+void FrameQueue::Flush()
+{
+    {
+        const std::unique_lock lock(mtx);
+        for (; count > 0; count--)
+        {
+            av_frame_unref(frames[read_index]);
+            read_index = (read_index + 1) % frames.size();
+        }
+
+        serial++;
+    }
+
+    can_push.notify_one();
+}
+
+int FrameQueue::Serial()
+{
+    const std::unique_lock lock(mtx);
+    return serial;
+}
+
+void FrameQueue::Wake()
+{
+    {
+        const std::unique_lock lock(mtx);
+        wake_pending = true;
+    }
+
+    can_push.notify_one();
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+/**
+ * \brief A bounded queue of decoded frames, filled by a decode thread ahead of the reader.
+ */
+class FrameQueue
+{
+public:
+    /**
+     * \brief Creates a new frame queue.
+     * \param capacity The maximum number of frames the queue can hold.
+     */
+    explicit FrameQueue(size_t capacity);
+    ~FrameQueue();
+
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    /**
+     * \brief Blocks until there is space in the queue or until the queue is woken with Wake().
+     * \return `true` if there is space in the queue; otherwise `false`.
+     */
+    bool WaitForSpace();
+
+    /**
+     * \brief Pushes a frame into the queue, taking over its references. The queue must have space.
+     * \param frame The frame to push. This will be reset to a blank frame.
+     */
+    void Push(AVFrame* frame);
+
+    /**
+     * \brief Pops the next frame from the queue, if one is available.
+     * \param frame The frame to move the popped frame's references into. Any existing references are released.
+     * \param serial The serial number of the popped frame.
+     * \return `true` if a frame was popped; otherwise `false`.
+     */
+    bool Pop(AVFrame* frame, int& serial);
+
+    /**
+     * \brief Discards all queued frames and increments the queue's serial number.
+     */
+    void Flush();
+
+    /**
+     * \brief Gets the current serial number of the queue. This changes every time the queue is flushed.
+     */
+    int Serial();
+
+    /**
+     * \brief Wakes the producer if it is blocked in WaitForSpace().
+     */
+    void Wake();
+
+private:
+    std::vector<AVFrame*> frames;
+    std::mutex mtx;
+    std::condition_variable can_push;
+    size_t read_index;
+    size_t count;
+    int serial;
+    bool wake_pending;
+};
@@ -0,0 +1,166 @@
+﻿#include "FrameRing.h"
+
+enum
+{
+    // Row alignment for converted frames; this keeps every row aligned for SIMD loads and stores
+    frame_row_alignment = 64,
+};
+
+FrameRing::FrameRing(const size_t capacity)
+    : next_generation{1},
+      latest_index{-1},
+      write_index{-1}
+{
+    slots.resize(capacity);
+    for (auto& slot : slots)
+    {
+        slot = Slot{};
+        slot.frame = av_frame_alloc();
+    }
+}
+
+FrameRing::~FrameRing()
+{
+    for (auto& slot : slots)
+    {
+        av_frame_free(&slot.frame);
+    }
+}
+
+FrameRing::Slot* FrameRing::ReserveSlot()
+{
+    const std::unique_lock lock(mtx);
+    for (auto i = 0; i < static_cast<int>(slots.size()); i++)
+    {
+        if (i != latest_index && slots[i].readers == 0)
+        {
+            write_index = i;
+            return &slots[i];
+        }
+    }
+
+    return nullptr;
+}
+
+void FrameRing::Publish(const double pts)
+{
+    const std::unique_lock lock(mtx);
+    if (write_index < 0)
+    {
+        return;
+    }
+
+    auto& slot = slots[write_index];
+    slot.pts = pts;
+    slot.generation = next_generation++;
+    latest_index = write_index;
+    write_index = -1;
+}
+
+bool FrameRing::BeginWrite(const int width, const int height, VideoFrameInfo& info)
+{
+    auto* slot = ReserveSlot();
+    if (!slot)
+    {
+        return false;
+    }
+
+    // Nobody else can touch this slot until it's published, so it can be reallocated without the lock
+    auto* frame = slot->frame;
+    if (frame->format != AV_PIX_FMT_BGRA || frame->width != width || frame->height != height ||
+        !av_frame_is_writable(frame))
+    {
+        av_frame_unref(frame);
+        frame->format = AV_PIX_FMT_BGRA;
+        frame->width = width;
+        frame->height = height;
+        if (av_frame_get_buffer(frame, frame_row_alignment) < 0)
+        {
+            av_frame_unref(frame);
+            const std::unique_lock lock(mtx);
+            write_index = -1;
+            return false;
+        }
+    }
+
+    info = VideoFrameInfo{};
+    info.data[0] = frame->data[0];
+    info.stride[0] = frame->linesize[0];
+    info.width = width;
+    info.height = height;
+    info.format = AV_PIX_FMT_BGRA;
+    return true;
+}
+
+void FrameRing::EndWrite(const double pts)
+{
+    Publish(pts);
+}
+
+bool FrameRing::PublishReference(const AVFrame* frame, const double pts)
+{
+    auto* slot = ReserveSlot();
+    if (!slot)
+    {
+        return false;
+    }
+
+    av_frame_unref(slot->frame);
+    if (av_frame_ref(slot->frame, frame) < 0)
+    {
+        const std::unique_lock lock(mtx);
+        write_index = -1;
+        return false;
+    }
+
+    Publish(pts);
+    return true;
+}
+
+bool FrameRing::Acquire(VideoFrameInfo& info)
+{
+    const std::unique_lock lock(mtx);
+    if (latest_index < 0)
+    {
+        return false;
+    }
+
+    auto& slot = slots[latest_index];
+    slot.readers++;
+
+    const auto* frame = slot.frame;
+    info = VideoFrameInfo{};
+    for (auto i = 0; i < 4; i++)
+    {
+        info.data[i] = frame->data[i];
+        info.stride[i] = frame->linesize[i];
+    }
+
+    info.width = frame->width;
+    info.height = frame->height;
+    info.format = frame->format;
+    info.color_space = frame->colorspace;
+    info.color_range = frame->color_range;
+    info.pts = slot.pts;
+    info.generation = slot.generation;
+    return true;
+}
+
+void FrameRing::Release(const int64_t generation)
+{
+    const std::unique_lock lock(mtx);
+    for (auto& slot : slots)
+    {
+        if (slot.generation == generation && slot.readers > 0)
+        {
+            slot.readers--;
+            return;
+        }
+    }
+}
+
+void FrameRing::Clear()
+{
+    const std::unique_lock lock(mtx);
+    latest_index = -1;
+}
@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+/**
+ * \brief A video frame that has been published to a frame ring. BGRA frames only use the first plane;
+ * planar YUV frames use one plane per component, or two for NV12.
+ */
+struct VideoFrameInfo
+{
+    uint8_t* data[4];
+    int stride[4];
+    int width;
+    int height;
+    int format;
+    int color_space;
+    int color_range;
+    double pts;
+    int64_t generation;
+};
+
+/**
+ * \brief A small ring of output video frames. The reader either converts each displayed frame into a free
+ * slot or references the decoder's own frame in it, and publishes the slot. Any number of consumers can then
+ * read the most recently published frame in place until they release it, without copying it out or calling
+ * back into the decoder.
+ */
+class FrameRing
+{
+public:
+    /**
+     * \brief Creates a new frame ring.
+     * \param capacity The number of frames in the ring. This should be at least 3, so that the producer
+     * can write a frame while another frame is published and an older one is still being read.
+     */
+    explicit FrameRing(size_t capacity);
+    ~FrameRing();
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    /**
+     * \brief Reserves a free slot for the producer to write a BGRA frame into, (re)allocating its buffer if
+     * needed. Only one slot can be reserved at a time.
+     * \param width The width of the frame, in pixels.
+     * \param height The height of the frame, in pixels.
+     * \param info The reserved slot's buffer and stride. This will be overwritten.
+     * \return `true` if a slot was reserved; `false` if every slot is still being read.
+     */
+    bool BeginWrite(int width, int height, VideoFrameInfo& info);
+
+    /**
+     * \brief Publishes the slot reserved by BeginWrite() as the latest frame.
+     * \param pts The presentation timestamp of the frame, in seconds.
+     */
+    void EndWrite(double pts);
+
+    /**
+     * \brief Publishes a new reference to a decoded frame as the latest frame, without copying its data.
+     * \param frame The frame to publish.
+     * \param pts The presentation timestamp of the frame, in seconds.
+     * \return `true` if the frame was published; `false` if every slot is still being read.
+     */
+    bool PublishReference(const AVFrame* frame, double pts);
+
+    /**
+     * \brief Acquires the most recently published frame. The frame's data remains valid until it is released.
+     * \param info The acquired frame. This will be overwritten.
+     * \return `true` if a frame was acquired; `false` if no frame has been published yet.
+     */
+    bool Acquire(VideoFrameInfo& info);
+
+    /**
+     * \brief Releases a frame acquired with Acquire().
+     * \param generation The generation of the frame to release.
+     */
+    void Release(int64_t generation);
+
+    /**
+     * \brief Unpublishes the latest frame, so that nothing can be acquired until the next frame is written.
+     */
+    void Clear();
+
+private:
+    struct Slot
+    {
+        AVFrame* frame;
+        double pts;
+        int64_t generation;
+        int readers;
+    };
+
+    std::vector<Slot> slots;
+    std::mutex mtx;
+    int64_t next_generation;
+    int latest_index;
+    int write_index;
+
+    Slot* ReserveSlot();
+    void Publish(double pts);
+};
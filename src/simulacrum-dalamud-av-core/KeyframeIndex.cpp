@@ -0,0 +1,243 @@
+﻿#include "KeyframeIndex.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+enum : uint32_t
+{
+    index_magic = 0x4946'4b53, // "SKFI"
+    index_version = 1,
+};
+
+std::mutex KeyframeIndex::cache_directory_mtx;
+std::string KeyframeIndex::cache_directory;
+
+// 64-bit FNV-1a, used to turn URIs into cache file names
+static uint64_t hash_uri(const char* uri)
+{
+    uint64_t hash = 0xcbf2'9ce4'8422'2325;
+    for (; *uri; uri++)
+    {
+        hash ^= static_cast<uint8_t>(*uri);
+        hash *= 0x100'0000'01b3;
+    }
+
+    return hash;
+}
+
+KeyframeIndex::KeyframeIndex()
+    : header{},
+      run_last_pts(AV_NOPTS_VALUE),
+      dirty(false)
+{
+}
+
+void KeyframeIndex::SetCacheDirectory(const char* directory)
+{
+    const std::unique_lock lock(cache_directory_mtx);
+    cache_directory = directory ? directory : "";
+}
+
+void KeyframeIndex::Open(const char* uri, AVFormatContext* format_ctx, const int stream_index)
+{
+    entries.clear();
+    cache_path.clear();
+    run_last_pts = AV_NOPTS_VALUE;
+    dirty = false;
+
+    header.magic = index_magic;
+    header.version = index_version;
+    header.file_size = format_ctx->pb ? avio_size(format_ctx->pb) : -1;
+    header.duration = format_ctx->duration;
+    header.time_base = format_ctx->streams[stream_index]->time_base;
+    header.entry_count = 0;
+
+    {
+        const std::unique_lock lock(cache_directory_mtx);
+        if (cache_directory.empty())
+        {
+            return;
+        }
+
+        // Live streams have no fixed set of keyframes to cache
+        if (header.duration == AV_NOPTS_VALUE)
+        {
+            return;
+        }
+
+        char file_name[32];
+        snprintf(file_name, sizeof file_name, "%016llx.kfi", static_cast<unsigned long long>(hash_uri(uri)));
+        cache_path = (std::filesystem::path(cache_directory) / file_name).string();
+    }
+
+    if (!Load())
+    {
+        return;
+    }
+
+    // Hand the cached keyframes to the demuxer too, for formats that seek using the generic index
+    const auto stream = format_ctx->streams[stream_index];
+    for (const auto& entry : entries)
+    {
+        if (entry.pos >= 0)
+        {
+            av_add_index_entry(stream, entry.pos, entry.pts, 0, 0, AVINDEX_KEYFRAME);
+        }
+    }
+}
+
+bool KeyframeIndex::Load()
+{
+    std::ifstream file(cache_path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    Header cached{};
+    if (!file.read(reinterpret_cast<char*>(&cached), sizeof cached))
+    {
+        return false;
+    }
+
+    // Discard the cache if the file it was built from appears to have changed
+    if (cached.magic != header.magic || cached.version != header.version ||
+        cached.file_size != header.file_size || cached.duration != header.duration ||
+        av_cmp_q(cached.time_base, header.time_base) != 0)
+    {
+        av_log(nullptr, AV_LOG_INFO, "[user] Ignoring stale keyframe index %s", cache_path.c_str());
+        return false;
+    }
+
+    // Make sure the entry count matches what's actually in the file before allocating anything for it
+    const auto entries_start = file.tellg();
+    file.seekg(0, std::ios::end);
+    const auto entries_size = static_cast<uint64_t>(file.tellg() - entries_start);
+    if (!file || entries_size % sizeof(Entry) != 0 || cached.entry_count != entries_size / sizeof(Entry))
+    {
+        av_log(nullptr, AV_LOG_WARNING, "[user] Ignoring truncated keyframe index %s", cache_path.c_str());
+        return false;
+    }
+
+    file.seekg(entries_start);
+    entries.resize(cached.entry_count);
+    if (!file.read(reinterpret_cast<char*>(entries.data()),
+                   static_cast<std::streamsize>(entries.size() * sizeof(Entry))))
+    {
+        entries.clear();
+        return false;
+    }
+
+    // Lookups binary search the entries, so they must be strictly ordered
+    if (std::adjacent_find(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+    {
+        return a.pts >= b.pts;
+    }) != entries.end())
+    {
+        av_log(nullptr, AV_LOG_WARNING, "[user] Ignoring unordered keyframe index %s", cache_path.c_str());
+        entries.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void KeyframeIndex::Save()
+{
+    if (!dirty || cache_path.empty())
+    {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), ec);
+
+    std::ofstream file(cache_path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        av_log(nullptr, AV_LOG_WARNING, "[user] Could not write keyframe index %s", cache_path.c_str());
+        return;
+    }
+
+    header.entry_count = entries.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof header);
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+    dirty = false;
+}
+
+void KeyframeIndex::Add(const int64_t pts, const int64_t pos)
+{
+    if (pts == AV_NOPTS_VALUE)
+    {
+        // We can't place this keyframe, but it still sits between the keyframes around it
+        BreakRun();
+        return;
+    }
+
+    auto it = std::lower_bound(entries.begin(), entries.end(), pts, [](const Entry& entry, const int64_t value)
+    {
+        return entry.pts < value;
+    });
+
+    if (it == entries.end() || it->pts != pts)
+    {
+        it = entries.insert(it, Entry{pts, pos, 0, 0});
+        dirty = true;
+    }
+
+    // If we demuxed straight here from the previous entry, there are no keyframes between them
+    if (run_last_pts != AV_NOPTS_VALUE && it != entries.begin())
+    {
+        if (auto& previous = *(it - 1); previous.pts == run_last_pts && !previous.next_known)
+        {
+            previous.next_known = 1;
+            dirty = true;
+        }
+    }
+
+    run_last_pts = pts;
+}
+
+void KeyframeIndex::BreakRun()
+{
+    run_last_pts = AV_NOPTS_VALUE;
+}
+
+void KeyframeIndex::MarkEnd()
+{
+    if (run_last_pts == AV_NOPTS_VALUE || entries.empty() || entries.back().pts != run_last_pts)
+    {
+        return;
+    }
+
+    if (!entries.back().next_known)
+    {
+        entries.back().next_known = 1;
+        dirty = true;
+    }
+}
+
+bool KeyframeIndex::FindPreceding(const int64_t pts, int64_t& keyframe_pts) const
+{
+    const auto it = std::upper_bound(entries.begin(), entries.end(), pts, [](const int64_t value, const Entry& entry)
+    {
+        return value < entry.pts;
+    });
+
+    if (it == entries.begin())
+    {
+        return false;
+    }
+
+    const auto& entry = *(it - 1);
+    if (!entry.next_known)
+    {
+        // There may be a closer keyframe we haven't seen yet
+        return false;
+    }
+
+    keyframe_pts = entry.pts;
+    return true;
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/**
+ * \brief An index of the keyframes in a video stream, built up while demuxing and cached on disk
+ * between sessions. Seeks that land in an indexed region can jump straight to the closest preceding
+ * keyframe, which bounds the number of frames that need to be decoded to reach the seek target.
+ */
+class KeyframeIndex
+{
+public:
+    KeyframeIndex();
+
+    KeyframeIndex(const KeyframeIndex&) = delete;
+    KeyframeIndex& operator=(const KeyframeIndex&) = delete;
+
+    /**
+     * \brief Sets the directory that keyframe indexes are cached in. Indexes are not cached if this is empty.
+     * \param directory The cache directory, or `nullptr` to disable caching.
+     */
+    static void SetCacheDirectory(const char* directory);
+
+    /**
+     * \brief Associates the index with a stream, loading any cached index for it.
+     * \param uri The URI the stream was opened from.
+     * \param format_ctx The format context the stream belongs to.
+     * \param stream_index The index of the stream to index.
+     */
+    void Open(const char* uri, AVFormatContext* format_ctx, int stream_index);
+
+    /**
+     * \brief Writes the index to the cache directory, if it has changed since it was loaded.
+     */
+    void Save();
+
+    /**
+     * \brief Records a demuxed keyframe.
+     * \param pts The keyframe's timestamp, in stream time base units. Keyframes without a timestamp are not
+     * recorded, and break the current run instead.
+     * \param pos The keyframe's byte position in the file, or -1 if it is unknown.
+     */
+    void Add(int64_t pts, int64_t pos);
+
+    /**
+     * \brief Notes that demuxing jumped to a new position, so the next keyframe isn't known to follow
+     * the last one directly.
+     */
+    void BreakRun();
+
+    /**
+     * \brief Notes that demuxing reached the end of the stream, so no keyframes follow the last one.
+     */
+    void MarkEnd();
+
+    /**
+     * \brief Finds the closest keyframe at or before a timestamp. This only succeeds if no unindexed
+     * keyframes could lie between the keyframe and the timestamp.
+     * \param pts The timestamp to search from, in stream time base units.
+     * \param keyframe_pts The timestamp of the keyframe that was found. This will be overwritten.
+     * \return `true` if a keyframe was found; otherwise `false`.
+     */
+    bool FindPreceding(int64_t pts, int64_t& keyframe_pts) const;
+
+private:
+    struct Entry
+    {
+        int64_t pts;
+        int64_t pos;
+        // Whether the next entry (or the end of the stream) directly follows this one
+        int32_t next_known;
+        int32_t reserved;
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        int64_t file_size;
+        int64_t duration;
+        AVRational time_base;
+        uint64_t entry_count;
+    };
+
+    static std::mutex cache_directory_mtx;
+    static std::string cache_directory;
+
+    std::vector<Entry> entries;
+    std::string cache_path;
+    Header header;
+    int64_t run_last_pts;
+    bool dirty;
+
+    bool Load();
+};
@@ -0,0 +1,66 @@
+﻿#include "PacketPool.h"
+
+enum
+{
+    initial_pool_capacity = 256,
+};
+
+PacketPool::PacketPool()
+    : acquired{},
+      allocated{},
+      released{}
+{
+    packets.reserve(initial_pool_capacity);
+}
+
+PacketPool::~PacketPool()
+{
+    for (auto* packet : packets)
+    {
+        av_packet_free(&packet);
+    }
+}
+
+AVPacket* PacketPool::Acquire()
+{
+    acquired.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        const std::unique_lock lock(mtx);
+        if (!packets.empty())
+        {
+            auto* packet = packets.back();
+            packets.pop_back();
+            return packet;
+        }
+    }
+
+    allocated.fetch_add(1, std::memory_order_relaxed);
+    return av_packet_alloc();
+}
+
+void PacketPool::Release(AVPacket* packet)
+{
+    if (!packet)
+    {
+        return;
+    }
+
+    // Drop the packet's data outside the lock, since that can free a large buffer
+    av_packet_unref(packet);
+    released.fetch_add(1, std::memory_order_relaxed);
+
+    const std::unique_lock lock(mtx);
+    packets.push_back(packet);
+}
+
+PacketPoolStats PacketPool::GetStats()
+{
+    const std::unique_lock lock(mtx);
+    return PacketPoolStats{
+        acquired.load(std::memory_order_relaxed),
+        allocated.load(std::memory_order_relaxed),
+        released.load(std::memory_order_relaxed),
+        static_cast<int64_t>(packets.size()),
+    };
+}
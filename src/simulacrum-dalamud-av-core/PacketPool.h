@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+/**
+ * \brief Counters describing how well a packet pool is recycling packets.
+ */
+struct PacketPoolStats
+{
+    int64_t acquired;
+    int64_t allocated;
+    int64_t released;
+    int64_t pooled;
+};
+
+/**
+ * \brief A pool of reusable AVPacket shells. Packets are handed out by the ingest thread and
+ * returned by the decoders, so that steady-state demuxing doesn't need to allocate any packets.
+ */
+class PacketPool
+{
+public:
+    PacketPool();
+    ~PacketPool();
+
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    /**
+     * \brief Takes an empty packet from the pool, allocating a new one if the pool is empty.
+     * \return An empty packet, or `nullptr` if a new packet could not be allocated.
+     */
+    AVPacket* Acquire();
+
+    /**
+     * \brief Unreferences a packet's data and returns the packet to the pool.
+     * \param packet The packet to return. This may be `nullptr`.
+     */
+    void Release(AVPacket* packet);
+
+    /**
+     * \brief Gets the pool's usage counters.
+     */
+    PacketPoolStats GetStats();
+
+private:
+    std::vector<AVPacket*> packets;
+    std::mutex mtx;
+    std::atomic<int64_t> acquired;
+    std::atomic<int64_t> allocated;
+    std::atomic<int64_t> released;
+};
@@ -1,43 +1,252 @@
 ﻿#include "PacketQueue.h"
 
+PacketQueue::PacketQueue(PacketPool& pool, const size_t max_bytes, const double max_duration)
+    : slots{},
+      slot_durations{},
+      pool{pool},
+      max_bytes{max_bytes},
+      max_duration{max_duration},
+      max_duration_ts{},
+      head{},
+      popped_bytes{},
+      popped_duration{},
+      tail{},
+      pushed_bytes{},
+      pushed_duration{},
+      flush_index{},
+      last_pushed_ts(AV_NOPTS_VALUE),
+      producer_signal{},
+      producer_waiting{},
+      wake_pending{},
+      consumer_signal{},
+      consumer_waiting{},
+      consumer_wake_pending{}
+{
+}
+
 PacketQueue::~PacketQueue()
 {
-    Flush();
+    // Nothing else can be touching the queue at this point
+    const auto end = tail.load(std::memory_order_relaxed);
+    for (auto index = head.load(std::memory_order_relaxed); index != end; index++)
+    {
+        pool.Release(slots[index & (capacity - 1)]);
+    }
 }
 
-void PacketQueue::Push(AVPacket* packet)
+bool PacketQueue::Push(AVPacket* packet)
 {
-    const std::unique_lock lock(mtx);
-    packets.push(packet);
+    const auto next_tail = tail.load(std::memory_order_relaxed);
+
+    while (IsFull(next_tail))
+    {
+        const auto signal = producer_signal.load(std::memory_order_acquire);
+
+        // Publish that we're about to sleep before checking again, so the consumer either sees
+        // the flag or we see the space it freed up
+        producer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // A wake that landed before the signal was loaded above won't change it again, so check for one here
+        if (IsFull(next_tail) && !wake_pending.load(std::memory_order_acquire))
+        {
+            producer_signal.wait(signal, std::memory_order_acquire);
+        }
+
+        producer_waiting.store(false, std::memory_order_relaxed);
+
+        if (wake_pending.exchange(false, std::memory_order_acq_rel) && IsFull(next_tail))
+        {
+            return false;
+        }
+    }
+
+    Store(next_tail, packet);
+    return true;
+}
+
+bool PacketQueue::PushOverLimit(AVPacket* packet)
+{
+    const auto next_tail = tail.load(std::memory_order_relaxed);
+    if (next_tail - head.load(std::memory_order_acquire) >= capacity)
+    {
+        return false;
+    }
+
+    Store(next_tail, packet);
+    return true;
+}
+
+void PacketQueue::Store(const size_t next_tail, AVPacket* packet)
+{
+    // Many demuxers leave the duration unset, so fall back to the distance between timestamps; otherwise
+    // the duration limit would never kick in for those streams
+    auto duration = packet->duration;
+    const auto ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    if (duration <= 0 && ts != AV_NOPTS_VALUE && last_pushed_ts != AV_NOPTS_VALUE && ts > last_pushed_ts)
+    {
+        duration = ts - last_pushed_ts;
+    }
+
+    if (duration < 0)
+    {
+        duration = 0;
+    }
+
+    if (ts != AV_NOPTS_VALUE)
+    {
+        last_pushed_ts = ts;
+    }
+
+    slots[next_tail & (capacity - 1)] = packet;
+    slot_durations[next_tail & (capacity - 1)] = duration;
+    pushed_bytes.store(pushed_bytes.load(std::memory_order_relaxed) + packet->size, std::memory_order_relaxed);
+    pushed_duration.store(pushed_duration.load(std::memory_order_relaxed) + duration,
+                          std::memory_order_relaxed);
+    tail.store(next_tail + 1, std::memory_order_release);
+    SignalConsumer();
 }
 
 bool PacketQueue::Pop(AVPacket*& packet)
 {
-    const std::unique_lock lock(mtx);
-    if (packets.empty())
+    const auto current_head = head.load(std::memory_order_relaxed);
+    auto index = current_head;
+
+    // Release anything the producer flushed since our last pop
+    const auto flush_end = flush_index.load(std::memory_order_acquire);
+    while (static_cast<ptrdiff_t>(flush_end - index) > 0)
+    {
+        Release(index++);
+    }
+
+    if (index == tail.load(std::memory_order_acquire))
     {
+        if (index != current_head)
+        {
+            head.store(index, std::memory_order_release);
+            SignalProducer();
+        }
+
         return false;
     }
 
-    auto* next_packet = packets.front();
-    packets.pop();
+    auto* next_packet = slots[index & (capacity - 1)];
+    popped_bytes.store(popped_bytes.load(std::memory_order_relaxed) + next_packet->size, std::memory_order_relaxed);
+    popped_duration.store(popped_duration.load(std::memory_order_relaxed) + slot_durations[index & (capacity - 1)],
+                          std::memory_order_relaxed);
+    head.store(index + 1, std::memory_order_release);
+    SignalProducer();
+
     packet = next_packet;
     return true;
 }
 
 void PacketQueue::Flush()
 {
-    const std::unique_lock lock(mtx);
-    while (!packets.empty())
+    // Whatever is pushed next doesn't follow on from the flushed packets
+    last_pushed_ts = AV_NOPTS_VALUE;
+    flush_index.store(tail.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+size_t PacketQueue::Size() const
+{
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+void PacketQueue::SetTimeBase(const AVRational time_base)
+{
+    max_duration_ts.store(static_cast<int64_t>(max_duration / av_q2d(time_base)), std::memory_order_relaxed);
+}
+
+bool PacketQueue::WaitForData()
+{
+    const auto current_head = head.load(std::memory_order_relaxed);
+    if (current_head != tail.load(std::memory_order_acquire))
     {
-        auto* packet = packets.front();
-        av_packet_free(&packet);
-        packets.pop();
+        return true;
     }
+
+    const auto signal = consumer_signal.load(std::memory_order_acquire);
+
+    // Same handshake as in Push(), mirrored for the consumer
+    consumer_waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (current_head == tail.load(std::memory_order_acquire) &&
+        !consumer_wake_pending.load(std::memory_order_acquire))
+    {
+        consumer_signal.wait(signal, std::memory_order_acquire);
+    }
+
+    consumer_waiting.store(false, std::memory_order_relaxed);
+    consumer_wake_pending.store(false, std::memory_order_relaxed);
+
+    return current_head != tail.load(std::memory_order_acquire);
+}
+
+void PacketQueue::WakeProducer()
+{
+    wake_pending.store(true, std::memory_order_release);
+    producer_signal.fetch_add(1, std::memory_order_release);
+    producer_signal.notify_one();
 }
 
-size_t PacketQueue::Size()
+bool PacketQueue::IsFull(const size_t next_tail) const
 {
-    const std::unique_lock lock(mtx);
-    return packets.size();
+    const auto current_head = head.load(std::memory_order_acquire);
+    if (next_tail == current_head)
+    {
+        // Always accept at least one packet, no matter how large it is
+        return false;
+    }
+
+    if (next_tail - current_head >= capacity)
+    {
+        return true;
+    }
+
+    const auto bytes = pushed_bytes.load(std::memory_order_relaxed) - popped_bytes.load(std::memory_order_relaxed);
+    const auto duration = pushed_duration.load(std::memory_order_relaxed)
+        - popped_duration.load(std::memory_order_relaxed);
+    const auto duration_limit = max_duration_ts.load(std::memory_order_relaxed);
+    return bytes >= max_bytes || duration_limit > 0 && duration >= duration_limit;
+}
+
+void PacketQueue::Release(const size_t index)
+{
+    auto* packet = slots[index & (capacity - 1)];
+    popped_bytes.store(popped_bytes.load(std::memory_order_relaxed) + packet->size, std::memory_order_relaxed);
+    popped_duration.store(popped_duration.load(std::memory_order_relaxed) + slot_durations[index & (capacity - 1)],
+                          std::memory_order_relaxed);
+    pool.Release(packet);
+}
+
+void PacketQueue::WakeConsumer()
+{
+    consumer_wake_pending.store(true, std::memory_order_release);
+    consumer_signal.fetch_add(1, std::memory_order_release);
+    consumer_signal.notify_one();
+}
+
+void PacketQueue::SignalProducer()
+{
+    // Pairs with the fence in Push(), so that we either see the waiting flag or the producer sees
+    // our updated head index
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producer_waiting.load(std::memory_order_relaxed))
+    {
+        producer_signal.fetch_add(1, std::memory_order_release);
+        producer_signal.notify_one();
+    }
+}
+
+void PacketQueue::SignalConsumer()
+{
+    // Pairs with the fence in WaitForData()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumer_waiting.load(std::memory_order_relaxed))
+    {
+        consumer_signal.fetch_add(1, std::memory_order_release);
+        consumer_signal.notify_one();
+    }
 }
@@ -1,23 +1,134 @@
 ﻿#pragma once
 
-#include <mutex>
-#include <queue>
+#include <array>
+#include <atomic>
+#include "PacketPool.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
 }
 
+/**
+ * \brief A fixed-capacity, lock-free packet queue for exactly one producer thread and one
+ * consumer thread. Push(), PushOverLimit(), Flush() and Wake() may only be called by the
+ * producer (or by a thread waking it, in the case of Wake()), and Pop() may only be called by the
+ * consumer.
+ */
 class PacketQueue
 {
 public:
+    /**
+     * \brief Creates a new packet queue with the provided limits.
+     * \param pool The pool that discarded packets are returned to.
+     * \param max_bytes The maximum total size of the queued packets, in bytes.
+     * \param max_duration The maximum total duration of the queued packets, in seconds. This is only
+     * enforced once the stream time base is known. Packets that don't carry a duration are counted as
+     * lasting until the next packet's timestamp.
+     */
+    PacketQueue(PacketPool& pool, size_t max_bytes, double max_duration);
     ~PacketQueue();
 
-    void Push(AVPacket* packet);
+    PacketQueue(const PacketQueue&) = delete;
+    PacketQueue& operator=(const PacketQueue&) = delete;
+
+    /**
+     * \brief Pushes a packet into the queue. If the queue is full, this blocks until the consumer
+     * frees up space or until the queue is woken with WakeProducer().
+     * \param packet The packet to push. The queue takes ownership of it only if this returns `true`.
+     * \return `true` if the packet was queued; otherwise `false`.
+     */
+    bool Push(AVPacket* packet);
+
+    /**
+     * \brief Pushes a packet into the queue without blocking, ignoring the byte and duration limits.
+     * This lets a stream's queue overshoot its limits while another stream is waiting for packets.
+     * \param packet The packet to push. The queue takes ownership of it only if this returns `true`.
+     * \return `true` if the packet was queued; `false` if every slot in the queue is taken.
+     */
+    bool PushOverLimit(AVPacket* packet);
+
+    /**
+     * \brief Pops the next packet from the queue, if one is available.
+     * \param packet The popped packet. The caller takes ownership of it.
+     * \return `true` if a packet was popped; otherwise `false`.
+     */
     bool Pop(AVPacket*& packet);
+
+    /**
+     * \brief Discards every packet that has been pushed so far. The packets are released by the
+     * consumer the next time it calls Pop(), so this is safe to call while the consumer is running.
+     */
     void Flush();
-    size_t Size();
+
+    /**
+     * \brief Gets the approximate number of packets in the queue.
+     */
+    size_t Size() const;
+
+    /**
+     * \brief Sets the time base of the packets in this queue, enabling the duration limit.
+     * \param time_base The stream time base.
+     */
+    void SetTimeBase(AVRational time_base);
+
+    /**
+     * \brief Blocks until the queue has at least one packet or until the queue is woken with
+     * WakeConsumer(). This may only be called by the consumer.
+     * \return `true` if the queue has at least one packet; otherwise `false`.
+     */
+    bool WaitForData();
+
+    /**
+     * \brief Wakes the producer if it is blocked in Push(), or makes its next blocking call to
+     * Push() return immediately if it isn't.
+     */
+    void WakeProducer();
+
+    /**
+     * \brief Wakes the consumer if it is blocked in WaitForData(), or makes its next call to
+     * WaitForData() return immediately if it isn't.
+     */
+    void WakeConsumer();
 
 private:
-    std::queue<AVPacket*> packets;
-    std::mutex mtx;
+    static constexpr size_t capacity = 1024;
+    static constexpr size_t cache_line_size = 64;
+
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    std::array<AVPacket*, capacity> slots;
+    // The duration each slot's packet counts for, which may be estimated from timestamps
+    std::array<int64_t, capacity> slot_durations;
+    PacketPool& pool;
+    size_t max_bytes;
+    double max_duration;
+    std::atomic<int64_t> max_duration_ts;
+
+    // Consumer-owned state
+    alignas(cache_line_size) std::atomic<size_t> head;
+    std::atomic<size_t> popped_bytes;
+    std::atomic<int64_t> popped_duration;
+
+    // Producer-owned state
+    alignas(cache_line_size) std::atomic<size_t> tail;
+    std::atomic<size_t> pushed_bytes;
+    std::atomic<int64_t> pushed_duration;
+    std::atomic<size_t> flush_index;
+    int64_t last_pushed_ts;
+
+    // Producer wakeup state
+    alignas(cache_line_size) std::atomic<uint32_t> producer_signal;
+    std::atomic<bool> producer_waiting;
+    std::atomic<bool> wake_pending;
+
+    // Consumer wakeup state
+    alignas(cache_line_size) std::atomic<uint32_t> consumer_signal;
+    std::atomic<bool> consumer_waiting;
+    std::atomic<bool> consumer_wake_pending;
+
+    bool IsFull(size_t next_tail) const;
+    void Store(size_t next_tail, AVPacket* packet);
+    void Release(size_t index);
+    void SignalProducer();
+    void SignalConsumer();
 };
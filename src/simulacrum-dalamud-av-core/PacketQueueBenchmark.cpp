@@ -0,0 +1,179 @@
+﻿#include "PacketQueueBenchmark.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "PacketQueue.h"
+
+// The number of packet shells cycled through the queue, which must exceed what the queue can hold
+constexpr size_t benchmark_packet_shells = 4096;
+// The byte budget of the benchmarked queues; every packet counts as one byte
+constexpr size_t benchmark_max_bytes = 1024;
+
+LegacyPacketQueue::LegacyPacketQueue(const size_t max_bytes, const double max_duration)
+    : max_bytes{max_bytes},
+      max_duration{max_duration},
+      max_duration_ts{},
+      bytes{},
+      duration{},
+      wake_pending{}
+{
+}
+
+LegacyPacketQueue::~LegacyPacketQueue()
+{
+    Flush();
+}
+
+bool LegacyPacketQueue::Push(AVPacket* packet)
+{
+    std::unique_lock lock(mtx);
+    can_push.wait(lock, [this] { return !IsFull() || wake_pending; });
+
+    wake_pending = false;
+    if (IsFull())
+    {
+        return false;
+    }
+
+    packets.push(packet);
+    bytes += packet->size;
+    duration += packet->duration;
+    return true;
+}
+
+bool LegacyPacketQueue::Pop(AVPacket*& packet)
+{
+    std::unique_lock lock(mtx);
+    if (packets.empty())
+    {
+        return false;
+    }
+
+    const auto was_full = IsFull();
+
+    auto* next_packet = packets.front();
+    packets.pop();
+    bytes -= next_packet->size;
+    duration -= next_packet->duration;
+    packet = next_packet;
+
+    if (was_full && !IsFull())
+    {
+        lock.unlock();
+        can_push.notify_one();
+    }
+
+    return true;
+}
+
+void LegacyPacketQueue::Flush()
+{
+    {
+        const std::unique_lock lock(mtx);
+        while (!packets.empty())
+        {
+            auto* packet = packets.front();
+            av_packet_free(&packet);
+            packets.pop();
+        }
+
+        bytes = 0;
+        duration = 0;
+    }
+
+    can_push.notify_one();
+}
+
+bool LegacyPacketQueue::IsFull() const
+{
+    if (packets.empty())
+    {
+        // Always accept at least one packet, no matter how large it is
+        return false;
+    }
+
+    return bytes >= max_bytes || max_duration_ts > 0 && duration >= max_duration_ts;
+}
+
+template <typename Queue>
+static double measure_push_pop(Queue& queue, const std::vector<AVPacket*>& shells, const int packet_count)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    // The queue never holds more than benchmark_max_bytes packets, so a shell has always been
+    // popped by the time the producer wraps around to it again
+    std::thread producer([&]
+    {
+        for (auto i = 0; i < packet_count; i++)
+        {
+            queue.Push(shells[i % shells.size()]);
+        }
+    });
+
+    for (auto popped = 0; popped < packet_count;)
+    {
+        AVPacket* packet;
+        if (queue.Pop(packet))
+        {
+            popped++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+double RunPacketQueueBenchmark(const bool legacy, const int packet_count)
+{
+    if (packet_count <= 0)
+    {
+        return -1;
+    }
+
+    std::vector<AVPacket*> shells;
+    shells.reserve(benchmark_packet_shells);
+    for (size_t i = 0; i < benchmark_packet_shells; i++)
+    {
+        auto* packet = av_packet_alloc();
+        if (packet == nullptr)
+        {
+            break;
+        }
+
+        packet->size = 1;
+        packet->duration = 1;
+        shells.push_back(packet);
+    }
+
+    auto elapsed = -1.0;
+    if (shells.size() == benchmark_packet_shells)
+    {
+        if (legacy)
+        {
+            LegacyPacketQueue queue(benchmark_max_bytes, 0);
+            elapsed = measure_push_pop(queue, shells, packet_count);
+        }
+        else
+        {
+            PacketPool pool;
+            PacketQueue queue(pool, benchmark_max_bytes, 0);
+            elapsed = measure_push_pop(queue, shells, packet_count);
+        }
+    }
+
+    for (auto* packet : shells)
+    {
+        // The shells don't own any data, so they can be freed directly
+        packet->size = 0;
+        av_packet_free(&packet);
+    }
+
+    return elapsed;
+}
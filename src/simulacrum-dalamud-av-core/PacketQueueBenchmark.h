@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#define DllExport __declspec(dllexport)
+
+/**
+ * \brief The mutex-guarded packet queue that PacketQueue replaced, kept so that the two can be
+ * benchmarked against each other. This is not used by the reader.
+ */
+class LegacyPacketQueue
+{
+public:
+    LegacyPacketQueue(size_t max_bytes, double max_duration);
+    ~LegacyPacketQueue();
+
+    LegacyPacketQueue(const LegacyPacketQueue&) = delete;
+    LegacyPacketQueue& operator=(const LegacyPacketQueue&) = delete;
+
+    bool Push(AVPacket* packet);
+    bool Pop(AVPacket*& packet);
+    void Flush();
+
+private:
+    std::queue<AVPacket*> packets;
+    std::mutex mtx;
+    std::condition_variable can_push;
+    size_t max_bytes;
+    double max_duration;
+    int64_t max_duration_ts;
+    size_t bytes;
+    int64_t duration;
+    bool wake_pending;
+
+    bool IsFull() const;
+};
+
+/**
+ * \brief Moves packets from a producer thread to a consumer thread through a packet queue.
+ * \param legacy `true` to use LegacyPacketQueue; `false` to use PacketQueue.
+ * \param packet_count The number of packets to push through the queue.
+ * \return The time it took for the consumer to pop every packet, in seconds, or a negative value
+ * if the benchmark could not be set up.
+ */
+double RunPacketQueueBenchmark(bool legacy, int packet_count);
+
+extern "C" {
+inline DllExport double PacketQueueBenchmarkRun(const int legacy, const int packet_count)
+{
+    return RunPacketQueueBenchmark(legacy != 0, packet_count);
+}
+}
@@ -1,19 +1,61 @@
-﻿#include <cassert>
+﻿#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <string>
 #include <windows.h>
 #include "VideoReader.h"
 
-typedef short sample_container;
+// Audio output format unless the reader options ask for a different one
+constexpr auto default_audio_sample_format = AV_SAMPLE_FMT_S16;
+constexpr int default_audio_channel_count = 2;
 
-constexpr auto out_sample_format = AV_SAMPLE_FMT_S16;
+// Upper bound for the number of output audio channels, matching the largest default layout (7.1)
+constexpr int max_audio_channel_count = 8;
 
-enum
-{
-    max_audio_frame_size = 192000,
-    max_audio_buffer_size = max_audio_frame_size * 3 / 2,
-    out_bits_per_sample = sizeof(sample_container) * 8,
-    out_audio_channels = 2,
-};
+// Resampled audio is decoded this far ahead of ReadAudioStream unless the reader options ask for a different duration
+constexpr int default_audio_buffer_duration_ms = 500;
+
+// Audio drift smaller than this is left alone, since the clock it is measured against isn't any more precise
+constexpr double audio_sync_threshold = 0.02;
+
+// The largest fraction of an audio frame that drift correction may add or remove
+constexpr double max_audio_compensation = 0.1;
+
+// Failed reads are retried after a delay that starts here and doubles up to the maximum, since most of them
+// are network hiccups that clear up on their own
+constexpr int min_ingest_retry_delay_ms = 10;
+constexpr int max_ingest_retry_delay_ms = 1000;
+
+// Per-stream packet queue limits; the ingest thread blocks once either of these is reached
+constexpr size_t max_audio_queue_bytes = 4 * 1024 * 1024;
+constexpr size_t max_video_queue_bytes = 32 * 1024 * 1024;
+constexpr double max_queue_duration = 5.0;
+
+// Default decoded frame queue sizes for pipelined decoding
+constexpr int default_audio_frame_queue_size = 16;
+constexpr int default_video_frame_queue_size = 4;
+
+// Upper bound for automatically-sized decoder thread pools; libavcodec gains little beyond this
+constexpr int max_auto_decoder_threads = 16;
+
+// Upper bound for automatically-sized conversion thread pools
+constexpr int max_auto_conversion_threads = 8;
+
+// Frames are only split into bands this tall or taller, so that small frames aren't dominated by handing out work
+constexpr int min_conversion_band_rows = 128;
+
+// Packets further than this behind the target timestamp are decoded in catch-up mode
+constexpr double catch_up_threshold = 0.5;
+
+// Scaling algorithm used unless the reader options ask for a different one
+constexpr int default_scaler_flags = SWS_BILINEAR;
+
+// The number of converted frames kept for AcquireFrame; one being written, one published, and two being read
+constexpr size_t frame_ring_size = 4;
+
+// The number of readers that currently have a file open, used to share cores between them
+static std::atomic<int> active_reader_count;
 
 // Ripped from
 // * https://github.com/bmewj/video-app
@@ -44,45 +86,134 @@ static AVPixelFormat correct_for_deprecated_pixel_format(const AVPixelFormat pix
     }
 }
 
+static void fit_output_size(const int source_width, const int source_height, const int requested_width,
+                            const int requested_height, int& output_width, int& output_height)
+{
+    output_width = requested_width > 0 ? requested_width : source_width;
+    output_height = requested_height > 0 ? requested_height : source_height;
+
+    // Preserve the source aspect ratio if only one dimension was requested
+    if (requested_width > 0 && requested_height <= 0 && source_width > 0)
+    {
+        output_height = max(1, static_cast<int>(static_cast<int64_t>(source_height) * requested_width / source_width));
+    }
+    else if (requested_height > 0 && requested_width <= 0 && source_height > 0)
+    {
+        output_width = max(1, static_cast<int>(static_cast<int64_t>(source_width) * requested_height / source_height));
+    }
+}
+
+// Pixel formats that are published as-is in planar output mode
+static bool is_passthrough_format(const int pix_fmt)
+{
+    return pix_fmt == AV_PIX_FMT_YUV420P || pix_fmt == AV_PIX_FMT_YUVJ420P || pix_fmt == AV_PIX_FMT_NV12;
+}
+
 static double pts_to_seconds(const int64_t pts_raw, const AVRational time_base)
 {
     return static_cast<double>(pts_raw) * av_q2d(time_base);
 }
 
+static Simulacrum::AV::Core::MediaStreamInfo describe_stream(const AVStream* stream, const int index)
+{
+    const auto* codec_params = stream->codecpar;
+    Simulacrum::AV::Core::MediaStreamInfo info{};
+    info.index = index;
+    info.media_type = codec_params->codec_type;
+    info.codec_id = codec_params->codec_id;
+    snprintf(info.codec_name, sizeof info.codec_name, "%s", avcodec_get_name(codec_params->codec_id));
+    if (const auto* language = av_dict_get(stream->metadata, "language", nullptr, 0))
+    {
+        snprintf(info.language, sizeof info.language, "%s", language->value);
+    }
+
+    // HLS variants only carry their bitrate in the playlist, which the demuxer exposes as metadata
+    info.bit_rate = codec_params->bit_rate;
+    if (const auto* variant_bit_rate = av_dict_get(stream->metadata, "variant_bitrate", nullptr, 0);
+        info.bit_rate == 0 && variant_bit_rate)
+    {
+        info.bit_rate = strtoll(variant_bit_rate->value, nullptr, 10);
+    }
+
+    if (codec_params->codec_type == AVMEDIA_TYPE_VIDEO)
+    {
+        info.width = codec_params->width;
+        info.height = codec_params->height;
+    }
+    else if (codec_params->codec_type == AVMEDIA_TYPE_AUDIO)
+    {
+        info.sample_rate = codec_params->sample_rate;
+        info.channel_count = codec_params->ch_layout.nb_channels;
+    }
+
+    return info;
+}
+
 Simulacrum::AV::Core::VideoReader::VideoReader()
     : width{},
       height{},
+      source_width{},
+      source_height{},
+      lowres{},
       sample_rate{},
+      sample_format(AV_SAMPLE_FMT_NONE),
       bits_per_sample{},
       audio_channel_count{},
       video_frame_delay{},
       supports_audio{},
+      supports_video{},
       audio_stream{},
       video_stream{},
-      audio_buffer_total_size{},
-      audio_buffer_size{},
-      audio_buffer_index{},
+      frame_ring(frame_ring_size),
+      requested_output_width{},
+      requested_output_height{},
+      requested_scaler_flags{},
+      output_changed{},
+      requested_max_frame_rate{},
+      video_source_format(AV_PIX_FMT_NONE),
+      audio_buffer_target_size{},
+      audio_clock_drift{},
+      audio_read_pts{},
+      indexed_stream_index(-1),
       video_last_frame_timestamp{},
+      video_frame_generation{},
+      video_output_generation{},
+      video_output_pts{},
+      video_frame_stale{},
       done{},
+      active{},
+      paused{},
+      ingest_stalled{},
+      described_stream_count{},
       av_format_ctx{},
-      sws_scaler_ctx{},
       swr_resampler_ctx{}
 {
-    audio_stream.packet_queue = new PacketQueue();
-    video_stream.packet_queue = new PacketQueue();
-    audio_buffer_pending = new uint8_t[max_audio_buffer_size];
-    memset(audio_buffer_pending, 0, max_audio_buffer_size);
+    audio_stream.packet_queue = new PacketQueue(packet_pool, max_audio_queue_bytes, max_queue_duration);
+    video_stream.packet_queue = new PacketQueue(packet_pool, max_video_queue_bytes, max_queue_duration);
+    audio_stream.current_frame = av_frame_alloc();
+    video_stream.current_frame = av_frame_alloc();
 }
 
 Simulacrum::AV::Core::VideoReader::~VideoReader()
 {
+    if (ingest_thread.joinable())
+    {
+        // The reader is being destroyed without having been closed, so stop our threads first
+        Close();
+    }
+
     delete audio_stream.packet_queue;
     delete video_stream.packet_queue;
-    delete[] audio_buffer_pending;
+    delete audio_stream.frame_queue;
+    delete video_stream.frame_queue;
+    av_frame_free(&audio_stream.current_frame);
+    av_frame_free(&video_stream.current_frame);
 }
 
-bool Simulacrum::AV::Core::VideoReader::Open(const char* uri)
+bool Simulacrum::AV::Core::VideoReader::Open(const char* uri, const VideoReaderOptions& options)
 {
+    this->options = options;
+
     av_format_ctx = avformat_alloc_context();
     if (!av_format_ctx)
     {
@@ -104,67 +235,158 @@ bool Simulacrum::AV::Core::VideoReader::Open(const char* uri)
         return false;
     }
 
-    // Find the first valid audio stream inside the file
-    audio_stream.stream_index = av_find_best_stream(av_format_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
-    if (audio_stream.stream_index < 0)
+    // Find the first valid audio stream inside the file, unless the caller doesn't want audio at all
+    audio_stream.stream_index = -1;
+    if (!options.disable_audio)
     {
-        // TODO: Soundless video files are valid but need special handling here
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not find audio stream in input file");
-        return false;
+        audio_stream.stream_index = av_find_best_stream(av_format_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+        if (audio_stream.stream_index < 0)
+        {
+            av_log(nullptr, AV_LOG_INFO, "[user] Could not find audio stream in input file");
+            audio_stream.stream_index = -1;
+        }
     }
 
-    supports_audio = audio_stream.stream_index != -1;
-
-    // Find the first valid video stream inside the file
-    video_stream.stream_index = av_find_best_stream(av_format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
-    if (video_stream.stream_index < 0)
+    // Find the first valid video stream inside the file, unless the caller only wants audio
+    video_stream.stream_index = -1;
+    if (!options.disable_video)
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not find video stream in input file");
-        return false;
+        video_stream.stream_index = av_find_best_stream(av_format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (video_stream.stream_index < 0)
+        {
+            av_log(nullptr, AV_LOG_INFO, "[user] Could not find video stream in input file");
+            video_stream.stream_index = -1;
+        }
     }
 
     const AVCodecParameters* audio_codec_params = nullptr;
     const AVCodec* audio_codec = nullptr;
-    if (!FindDecoder(audio_stream.stream_index, audio_codec_params, audio_codec))
+    if (audio_stream.stream_index != -1 && !FindDecoder(audio_stream.stream_index, audio_codec_params, audio_codec))
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not find audio decoder");
-        return false;
+        av_log(nullptr, AV_LOG_WARNING, "[user] Could not find audio decoder, skipping audio");
+        audio_stream.stream_index = -1;
     }
 
+    supports_audio = audio_stream.stream_index != -1;
+
     const AVCodecParameters* video_codec_params = nullptr;
     const AVCodec* video_codec = nullptr;
-    if (!FindDecoder(video_stream.stream_index, video_codec_params, video_codec))
+    if (video_stream.stream_index != -1 && !FindDecoder(video_stream.stream_index, video_codec_params, video_codec))
+    {
+        av_log(nullptr, AV_LOG_WARNING, "[user] Could not find video decoder, skipping video");
+        video_stream.stream_index = -1;
+    }
+
+    supports_video = video_stream.stream_index != -1;
+
+    if (!supports_audio && !supports_video)
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not find video decoder");
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not find any audio or video stream to open");
         return false;
     }
 
+    described_stream_count = 0;
+    UpdateStreamDescriptions();
+
     if (supports_audio)
     {
-        sample_rate = audio_codec_params->sample_rate;
-        bits_per_sample = out_bits_per_sample;
-        audio_channel_count = out_audio_channels;
+        // The resampler converts to whatever the caller asked for in the same pass that it converts to packed samples
+        const auto requested_sample_format = options.audio_sample_format
+                                                 ? static_cast<AVSampleFormat>(options.audio_sample_format)
+                                                 : default_audio_sample_format;
+        if (requested_sample_format != AV_SAMPLE_FMT_S16 && requested_sample_format != AV_SAMPLE_FMT_FLT)
+        {
+            av_log(nullptr, AV_LOG_ERROR, "[user] Unsupported audio sample format: %d", options.audio_sample_format);
+            return false;
+        }
+
+        if (options.audio_sample_rate < 0 || options.audio_channel_count < 0 ||
+            options.audio_channel_count > max_audio_channel_count)
+        {
+            av_log(nullptr, AV_LOG_ERROR, "[user] Unsupported audio output: %d Hz, %d channels",
+                   options.audio_sample_rate, options.audio_channel_count);
+            return false;
+        }
+
+        sample_rate = options.audio_sample_rate > 0 ? options.audio_sample_rate : audio_codec_params->sample_rate;
+        sample_format = requested_sample_format;
+        bits_per_sample = av_get_bytes_per_sample(requested_sample_format) * 8;
+        audio_channel_count = options.audio_channel_count > 0
+                                  ? options.audio_channel_count
+                                  : default_audio_channel_count;
         audio_stream.time_base = av_format_ctx->streams[audio_stream.stream_index]->time_base;
+        audio_stream.packet_queue->SetTimeBase(audio_stream.time_base);
+
+        // Size the audio buffer for the read-ahead duration, plus some headroom for the frame that crosses it
+        const auto block_alignment = audio_channel_count * (bits_per_sample / 8);
+        const auto audio_buffer_duration_ms = options.audio_buffer_duration > 0
+                                                  ? options.audio_buffer_duration
+                                                  : default_audio_buffer_duration_ms;
+        audio_buffer_target_size = static_cast<size_t>(static_cast<int64_t>(sample_rate) * audio_buffer_duration_ms /
+            1000) * block_alignment;
+        resampled_audio.Reset(sample_rate * block_alignment, block_alignment, audio_buffer_target_size * 3 / 2);
     }
 
-    width = video_codec_params->width;
-    height = video_codec_params->height;
-    video_stream.time_base = av_format_ctx->streams[video_stream.stream_index]->time_base;
+    requested_output_width = options.output_width;
+    requested_output_height = options.output_height;
+    requested_scaler_flags = options.scaler_flags;
+    requested_max_frame_rate = options.max_frame_rate;
+    if (supports_video)
+    {
+        source_width = video_codec_params->width;
+        source_height = video_codec_params->height;
+        fit_output_size(source_width, source_height, requested_output_width, requested_output_height, width,
+                        height);
+        video_stream.time_base = av_format_ctx->streams[video_stream.stream_index]->time_base;
+        video_stream.packet_queue->SetTimeBase(video_stream.time_base);
+        keyframe_index.Open(uri, av_format_ctx, video_stream.stream_index);
+        indexed_stream_index = video_stream.stream_index;
+    }
+    else
+    {
+        // Audio-only readers have no frames to size
+        indexed_stream_index = -1;
+        source_width = 0;
+        source_height = 0;
+        width = 0;
+        height = 0;
+        lowres = 0;
+    }
 
     // Set up a codec context for the audio decoder
-    if (!InitializeCodecContext(audio_stream.codec_ctx, *audio_codec_params, *audio_codec))
+    if (supports_audio && !InitializeCodecContext(audio_stream.codec_ctx, *audio_codec_params, *audio_codec, 1, 0, 0))
     {
         av_log(nullptr, AV_LOG_ERROR, "[user] Could not initialize audio decoder context");
         return false;
     }
 
-    // Set up a codec context for the video decoder
-    if (!InitializeCodecContext(video_stream.codec_ctx, *video_codec_params, *video_codec))
+    // Set up a codec context for the video decoder, along with everything that converts its frames
+    if (supports_video && !InitializeVideoDecoder(*video_codec_params, *video_codec))
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not initialize video decoder context");
         return false;
     }
 
+    if (options.pipelined_decoding)
+    {
+        if (supports_audio)
+        {
+            StartDecodeThread(audio_stream, options.audio_frame_queue_size > 0
+                                                ? options.audio_frame_queue_size
+                                                : default_audio_frame_queue_size);
+        }
+
+        if (supports_video)
+        {
+            StartDecodeThread(video_stream, options.video_frame_queue_size > 0
+                                                ? options.video_frame_queue_size
+                                                : default_video_frame_queue_size);
+        }
+    }
+
+    // Only count the reader once nothing else can fail, since a failed Open isn't necessarily followed by Close
+    active = true;
+    active_reader_count++;
+
     ingest_thread = std::thread(&VideoReader::Ingest, this);
 
     return true;
@@ -172,305 +394,959 @@ bool Simulacrum::AV::Core::VideoReader::Open(const char* uri)
 
 int Simulacrum::AV::Core::VideoReader::ReadAudioStream(uint8_t* audio_buffer, const int len, double& pts)
 {
-    if (audio_stream.flush_requested || audio_buffer_size == 0)
+    if (!supports_audio || len <= 0)
     {
-        // Do an initial decode in case we have no data, so the pts we return is correct
-        if (!DecodeAudioFrame())
+        return 0;
+    }
+
+    const auto flush_pending = IsFlushPending(audio_stream);
+    if (flush_pending)
+    {
+        // Everything buffered so far is from before the seek
+        resampled_audio.Clear();
+        ResetAudioDrift();
+        if (swr_resampler_ctx)
         {
-            // Failed to decode audio frame, nothing to do
-            return 0;
+            // Drop the resampler along with the samples it is holding back and any compensation; it is rebuilt
+            // from the next frame, which may come from a different stream in a different format
+            swr_free(&swr_resampler_ctx);
+            swr_resampler_ctx = nullptr;
         }
     }
 
-    // Return the estimated pts of the beginning of the audio buffer
-    const auto block_alignment = audio_channel_count * (bits_per_sample / 8);
-    const auto average_bytes_per_second = sample_rate * block_alignment;
-    const auto best_effort_timestamp = audio_stream.current_frame.best_effort_timestamp;
-    const auto pts_base = pts_to_seconds(best_effort_timestamp, audio_stream.time_base);
-    const auto initial_audio_buffer_index = audio_buffer_index;
-    pts = pts_base + initial_audio_buffer_index / static_cast<double>(average_bytes_per_second);
-
-    int n_read = 0;
-    while (n_read < len)
+    // Top up the buffer only once it runs short, so that most reads are a single copy
+    const auto size = static_cast<size_t>(len);
+    if (flush_pending || resampled_audio.Size() < size)
     {
-        if (audio_stream.flush_requested || audio_buffer_size == 0 && !DecodeAudioFrame())
+        const auto fill_size = max(size, audio_buffer_target_size);
+        do
         {
-            // Failed to decode audio frame, nothing to do
-            break;
+            if (!DecodeAudioFrame())
+            {
+                // Failed to decode audio frame, return whatever is buffered
+                break;
+            }
         }
+        while (resampled_audio.Size() < fill_size && !IsFlushPending(audio_stream));
+    }
 
-        const auto to_read = min(len - n_read, audio_buffer_size);
-        memcpy(audio_buffer + n_read, audio_buffer_pending + audio_buffer_index, to_read);
-        n_read += to_read;
-        audio_buffer_index += to_read;
-        audio_buffer_size -= to_read;
+    const auto n_read = resampled_audio.Read(audio_buffer, size, pts);
+    if (n_read > 0)
+    {
+        // Remember where playback will continue from, for switching streams
+        const auto bytes_per_second = sample_rate * audio_channel_count * (bits_per_sample / 8);
+        audio_read_pts = pts + static_cast<double>(n_read) / bytes_per_second;
     }
 
-    return n_read;
+    return static_cast<int>(n_read);
 }
 
-bool Simulacrum::AV::Core::VideoReader::ReadVideoFrame(
+Simulacrum::AV::Core::VideoFrameStatus Simulacrum::AV::Core::VideoReader::ReadVideoFrame(
     uint8_t* frame_buffer,
     const double& target_pts,
     double& pts)
 {
-    do
-    {
-        if (!DecodeVideoFrame())
-        {
-            return false;
-        }
-
-        const auto best_effort_timestamp = video_stream.current_frame.best_effort_timestamp;
-
-        pts = pts_to_seconds(best_effort_timestamp, video_stream.time_base);
-
-        const auto pts_diff = best_effort_timestamp - video_last_frame_timestamp;
-        video_frame_delay = pts_to_seconds(pts_diff, video_stream.time_base);
+    return ReadVideoFrame(frame_buffer, 0, 0, target_pts, pts);
+}
 
-        video_last_frame_timestamp = best_effort_timestamp;
+Simulacrum::AV::Core::VideoFrameStatus Simulacrum::AV::Core::VideoReader::ReadVideoFrame(
+    uint8_t* frame_buffer,
+    const int buffer_size,
+    const int stride,
+    const double& target_pts,
+    double& pts)
+{
+    if (!DecodeVideoFrameAt(target_pts, pts))
+    {
+        return VideoFrameStatus::error;
     }
-    while (pts < target_pts);
 
-    // Initialize the scaler if needed, now that some data has been decoded into the codec context
-    if (!sws_scaler_ctx && !InitializeVideoScaler())
+    if (!IsVideoOutputStale())
     {
-        return false;
+        // The caller already has this frame, so don't convert it again
+        return VideoFrameStatus::no_new_frame;
     }
 
-    if (frame_buffer)
+    if (!frame_buffer)
     {
-        CopyScaledVideo(frame_buffer);
+        return VideoFrameStatus::new_frame;
     }
 
-    return true;
-}
-
-bool Simulacrum::AV::Core::VideoReader::SeekAudioStream(const double target_pts)
-{
-    audio_stream.seek_pts = target_pts;
-    audio_stream.seek_requested = true;
+    auto size_changed = false;
+    if (!InitializeVideoScaler(size_changed))
+    {
+        return VideoFrameStatus::error;
+    }
 
-    // This may or may not cause problems
-    const auto last_pts = pts_to_seconds(video_last_frame_timestamp, video_stream.time_base);
-    audio_stream.seek_flags = target_pts - last_pts > 0 ? 0 : AVSEEK_FLAG_BACKWARD;
+    if (size_changed)
+    {
+        // The caller's buffer was sized for the previous frames; let them reallocate it before writing anything
+        return VideoFrameStatus::size_changed;
+    }
 
-    return true;
-}
+    const auto row_stride = stride > 0 ? stride : width * 4;
+    if (row_stride < width * 4 ||
+        buffer_size > 0 && buffer_size < static_cast<int64_t>(row_stride) * (height - 1) + width * 4)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Frame buffer is too small for a %dx%d frame", width, height);
+        return VideoFrameStatus::error;
+    }
 
-bool Simulacrum::AV::Core::VideoReader::SeekVideoFrame(const double target_pts)
-{
-    video_stream.seek_pts = target_pts;
-    video_stream.seek_requested = true;
+    if (!CopyScaledVideo(frame_buffer, row_stride))
+    {
+        return VideoFrameStatus::error;
+    }
 
-    const auto last_pts = pts_to_seconds(video_last_frame_timestamp, video_stream.time_base);
-    video_stream.seek_flags = target_pts - last_pts > 0 ? 0 : AVSEEK_FLAG_BACKWARD;
+    video_output_generation = video_frame_generation;
+    video_output_pts = pts;
 
-    return true;
+    return VideoFrameStatus::new_frame;
 }
 
-void Simulacrum::AV::Core::VideoReader::Close()
+Simulacrum::AV::Core::VideoFrameStatus Simulacrum::AV::Core::VideoReader::PublishVideoFrame(
+    const double& target_pts,
+    double& pts)
 {
-    done = true;
-    ingest_thread.join();
+    if (!DecodeVideoFrameAt(target_pts, pts))
+    {
+        return VideoFrameStatus::error;
+    }
 
-    if (sws_scaler_ctx)
+    if (!IsVideoOutputStale())
     {
-        sws_freeContext(sws_scaler_ctx);
-        sws_scaler_ctx = nullptr;
+        // The frame ring already has this frame
+        return VideoFrameStatus::no_new_frame;
     }
 
-    if (swr_resampler_ctx)
+    if (options.planar_output && is_passthrough_format(video_stream.current_frame->format))
     {
-        swr_free(&swr_resampler_ctx);
-        swr_resampler_ctx = nullptr;
+        // Hand out the decoder's own planes, and leave color conversion to the consumer
+        if (!frame_ring.PublishReference(video_stream.current_frame, pts))
+        {
+            return VideoFrameStatus::error;
+        }
+
+        if (output_changed.exchange(false))
+        {
+            // Passthrough frames aren't scaled, so the new output size only matters once frames need converting
+            // again; forget the source format so the scaler is reconfigured for it then
+            video_source_format = AV_PIX_FMT_NONE;
+        }
+
+        video_output_generation = video_frame_generation;
+        video_output_pts = pts;
+        return VideoFrameStatus::new_frame;
     }
 
-    if (av_format_ctx)
+    auto size_changed = false;
+    if (!InitializeVideoScaler(size_changed))
     {
-        avformat_close_input(&av_format_ctx);
-        avformat_free_context(av_format_ctx);
-        av_format_ctx = nullptr;
+        return VideoFrameStatus::error;
     }
 
-    if (audio_stream.codec_ctx)
+    // The frame ring sizes its buffers to each frame, so the frame can be published at its new size right away
+    VideoFrameInfo info{};
+    if (!frame_ring.BeginWrite(width, height, info))
     {
-        avcodec_free_context(&audio_stream.codec_ctx);
-        audio_stream.codec_ctx = nullptr;
+        // Every buffer is still being read; drop this frame rather than blocking the decoder
+        return VideoFrameStatus::error;
     }
 
-    if (video_stream.codec_ctx)
+    if (!CopyScaledVideo(info.data[0], info.stride[0]))
     {
-        avcodec_free_context(&video_stream.codec_ctx);
-        video_stream.codec_ctx = nullptr;
+        return VideoFrameStatus::error;
     }
+
+    frame_ring.EndWrite(pts);
+    video_output_generation = video_frame_generation;
+    video_output_pts = pts;
+
+    return size_changed ? VideoFrameStatus::size_changed : VideoFrameStatus::new_frame;
 }
 
-bool Simulacrum::AV::Core::VideoReader::FindDecoder(
-    const int stream_index,
-    const AVCodecParameters*& codec_params,
-    const AVCodec*& codec) const
+bool Simulacrum::AV::Core::VideoReader::AcquireFrame(VideoFrameInfo& info)
 {
-    const auto* found_codec_params = av_format_ctx->streams[stream_index]->codecpar;
-    const auto* found_codec = avcodec_find_decoder(found_codec_params->codec_id);
-    if (!found_codec)
+    if (!frame_ring.Acquire(info))
     {
         return false;
     }
 
-    codec_params = found_codec_params;
-    codec = found_codec;
+    if (info.format != AV_PIX_FMT_BGRA)
+    {
+        // Spell out the color metadata for planar frames, so consumers don't need to guess it themselves;
+        // this resolves it the same way our own BGRA conversions do
+        info.color_range = ResolveColorRange(static_cast<AVColorRange>(info.color_range), info.format);
+        info.color_space = ResolveColorSpace(static_cast<AVColorSpace>(info.color_space), info.height);
+        info.format = correct_for_deprecated_pixel_format(static_cast<AVPixelFormat>(info.format));
+    }
 
     return true;
 }
 
-bool Simulacrum::AV::Core::VideoReader::InitializeCodecContext(
-    AVCodecContext*& codec_ctx,
-    const AVCodecParameters& codec_params,
-    const AVCodec& codec)
+void Simulacrum::AV::Core::VideoReader::ReleaseFrame(const int64_t generation)
 {
-    codec_ctx = avcodec_alloc_context3(&codec);
-    if (!codec_ctx)
-    {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not allocate decoder context");
-        return false;
-    }
+    frame_ring.Release(generation);
+}
 
-    if (avcodec_parameters_to_context(codec_ctx, &codec_params) < 0)
+bool Simulacrum::AV::Core::VideoReader::SeekAudioStream(const double target_pts)
+{
+    if (!supports_audio)
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not copy decoder context");
         return false;
     }
 
-    if (avcodec_open2(codec_ctx, &codec, nullptr) < 0)
+    // Judge the direction by the audio itself, since audio-only readers have no video position to go by
+    audio_stream.seek_flags = target_pts > audio_read_pts ? 0 : AVSEEK_FLAG_BACKWARD;
+    audio_stream.seek_pts = target_pts;
+    audio_stream.seek_requested = true;
+
+    // The ingest thread may be parked or blocked on a full queue
+    WakeIngest();
+
+    return true;
+}
+
+bool Simulacrum::AV::Core::VideoReader::SeekVideoFrame(const double target_pts)
+{
+    if (!supports_video)
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not open decoder");
         return false;
     }
 
+    video_stream.seek_pts = target_pts;
+    video_stream.catch_up_pts = target_pts;
+    video_stream.seek_requested = true;
+
+    const auto last_pts = pts_to_seconds(video_last_frame_timestamp, video_stream.time_base);
+    video_stream.seek_flags = target_pts - last_pts > 0 ? 0 : AVSEEK_FLAG_BACKWARD;
+
+    // The ingest thread may be parked or blocked on a full queue
+    WakeIngest();
+
     return true;
 }
 
-bool Simulacrum::AV::Core::VideoReader::DecodeAudioFrame()
+int Simulacrum::AV::Core::VideoReader::GetStreamCount() const
+{
+    const std::unique_lock lock(stream_descriptions_mtx);
+    return static_cast<int>(stream_descriptions.size());
+}
+
+bool Simulacrum::AV::Core::VideoReader::GetStreamInfo(const int index, MediaStreamInfo& info) const
 {
-    if (audio_stream.flush_requested)
     {
-        // Handle audio stream flush requests
-        audio_stream.flush_requested = false;
-        avcodec_flush_buffers(audio_stream.codec_ctx);
+        // The format context belongs to the ingest thread, so this reads from its last snapshot instead
+        const std::unique_lock lock(stream_descriptions_mtx);
+        if (index < 0 || index >= static_cast<int>(stream_descriptions.size()))
+        {
+            return false;
+        }
+
+        info = stream_descriptions[index];
     }
 
-    AVPacket* next_packet_raw;
-    if (!audio_stream.packet_queue->Pop(next_packet_raw))
+    // A switch that the ingest thread hasn't picked up yet already counts as the selection
+    info.selected = false;
+    for (const auto* selected_stream : {&audio_stream, &video_stream})
     {
-        return false;
+        const auto pending_index = selected_stream->switch_stream_index.load();
+        info.selected |= index == (pending_index != -1 ? pending_index : selected_stream->stream_index.load());
     }
 
-    // Set up the packet to be disposed at the end of the scope
-    const std::shared_ptr<AVPacket*> next_packet(&next_packet_raw, av_packet_free);
+    return true;
+}
 
-    int result = avcodec_send_packet(audio_stream.codec_ctx, *next_packet);
-    if (result < 0)
+bool Simulacrum::AV::Core::VideoReader::SelectStream(const int index)
+{
+    MediaStreamInfo info;
+    if (!GetStreamInfo(index, info))
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Error submitting packet for decoding: %s", av_make_error(result));
         return false;
     }
 
-    result = avcodec_receive_frame(audio_stream.codec_ctx, &audio_stream.current_frame);
-    if (result < 0)
+    StreamInfo* stream;
+    if (info.media_type == AVMEDIA_TYPE_AUDIO && supports_audio)
+    {
+        stream = &audio_stream;
+    }
+    else if (info.media_type == AVMEDIA_TYPE_VIDEO && supports_video)
+    {
+        stream = &video_stream;
+    }
+    else
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Error decoding frame: %s", av_make_error(result));
         return false;
     }
 
-    // Initialize the resampler if needed, now that some data has been decoded into the codec context
-    if (!swr_resampler_ctx && !InitializeAudioResampler())
+    if (!avcodec_find_decoder(static_cast<AVCodecID>(info.codec_id)))
     {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not find decoder for stream %d", index);
         return false;
     }
 
-    const auto req_size = av_samples_get_buffer_size(nullptr, audio_channel_count,
-                                                     audio_stream.current_frame.nb_samples, out_sample_format, 1);
-    if (req_size < 0)
+    if (index == stream->stream_index && stream->switch_stream_index == -1)
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not get required audio buffer size");
-        return false;
+        return true;
     }
 
-    assert(max_audio_buffer_size - audio_buffer_size >= req_size);
+    // The demuxer has already read past the current position, so seek back to pick up the new stream from there.
+    // That repositions every stream, so all of them are refilled from the current position.
+    if (supports_audio)
+    {
+        audio_stream.seek_pts = audio_read_pts;
+        audio_stream.seek_flags = AVSEEK_FLAG_BACKWARD;
+    }
 
-    // Resample the audio into our expected format
-    int sample_count;
-    if (!CopyResampledAudio(audio_buffer_pending, sample_count))
+    if (supports_video)
     {
-        return false;
+        video_stream.seek_pts = video_stream.catch_up_pts;
+        video_stream.seek_flags = AVSEEK_FLAG_BACKWARD;
     }
 
-    assert(audio_channel_count * sample_count * static_cast<int>(sizeof(sample_container)) == req_size);
+    stream->switch_stream_index = index;
+    audio_stream.seek_requested = supports_audio;
+    video_stream.seek_requested = supports_video;
 
-    audio_buffer_index = 0;
-    audio_buffer_size = req_size;
-    audio_buffer_total_size = req_size;
+    // The ingest thread may be parked or blocked on a full queue
+    WakeIngest();
 
     return true;
 }
 
-bool Simulacrum::AV::Core::VideoReader::DecodeVideoFrame()
+void Simulacrum::AV::Core::VideoReader::SetOutputSize(const int output_width, const int output_height,
+                                                     const int scaler_flags)
 {
-    if (video_stream.flush_requested)
-    {
-        // Handle video stream flush requests
-        video_stream.flush_requested = false;
-        avcodec_flush_buffers(video_stream.codec_ctx);
-    }
+    // The scaler is owned by whichever thread reads frames, so just leave it a note to reconfigure itself
+    const std::unique_lock lock(output_mtx);
+    requested_output_width = output_width;
+    requested_output_height = output_height;
+    requested_scaler_flags = scaler_flags;
+    output_changed = true;
+}
 
-    AVPacket* next_packet_raw;
-    if (!video_stream.packet_queue->Pop(next_packet_raw))
-    {
-        return false;
-    }
+void Simulacrum::AV::Core::VideoReader::SetMaxFrameRate(const int max_frame_rate)
+{
+    requested_max_frame_rate = max_frame_rate;
+}
 
-    // Set up the packet to be disposed at the end of the scope
-    const std::shared_ptr<AVPacket*> next_packet(&next_packet_raw, av_packet_free);
+void Simulacrum::AV::Core::VideoReader::SyncAudioClock(const double audio_pts, const double master_pts)
+{
+    const std::unique_lock lock(audio_sync_mtx);
 
-    int result = avcodec_send_packet(video_stream.codec_ctx, *next_packet);
-    if (result < 0)
+    // Corrections applied to audio that hasn't played yet will show up in later measurements, so don't count them twice
+    auto pending_correction = 0.0;
+    std::erase_if(audio_corrections, [&](const AudioCorrection& correction)
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Error submitting packet for decoding: %s", av_make_error(result));
-        return false;
-    }
+        if (correction.pts <= audio_pts)
+        {
+            return true;
+        }
 
-    result = avcodec_receive_frame(video_stream.codec_ctx, &video_stream.current_frame);
-    if (result < 0)
-    {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Error decoding frame: %s", av_make_error(result));
+        pending_correction += correction.duration;
         return false;
-    }
+    });
 
-    return true;
+    audio_clock_drift = audio_pts - master_pts - pending_correction;
 }
 
-int Simulacrum::AV::Core::VideoReader::SeekAudioFrameInternal()
+void Simulacrum::AV::Core::VideoReader::Pause()
 {
-    const auto audio_seek_frame = static_cast<int64_t>(audio_stream.seek_pts / av_q2d(audio_stream.time_base));
-    const auto result = av_seek_frame(av_format_ctx, audio_stream.stream_index, audio_seek_frame,
-                                      audio_stream.seek_flags);
-    if (result < 0)
+    const std::unique_lock lock(ingest_mtx);
+    paused = true;
+}
+
+void Simulacrum::AV::Core::VideoReader::Play()
+{
+    {
+        const std::unique_lock lock(ingest_mtx);
+        paused = false;
+    }
+
+    ingest_cv.notify_one();
+}
+
+PacketPoolStats Simulacrum::AV::Core::VideoReader::GetPacketPoolStats()
+{
+    return packet_pool.GetStats();
+}
+
+void Simulacrum::AV::Core::VideoReader::Close()
+{
+    done = true;
+    WakeIngest();
+    if (ingest_thread.joinable())
+    {
+        ingest_thread.join();
+    }
+
+    for (auto* stream : {&audio_stream, &video_stream})
+    {
+        if (stream->decode_thread.joinable())
+        {
+            WakeDecoder(*stream);
+            stream->decode_thread.join();
+        }
+    }
+
+    frame_ring.Clear();
+    video_source_format = AV_PIX_FMT_NONE;
+    video_frame_generation = 0;
+    video_output_generation = 0;
+    video_output_pts = 0;
+    video_frame_stale = false;
+
+    if (active)
+    {
+        active = false;
+        active_reader_count--;
+
+        // The ingest thread has stopped, so the index is ours to write out
+        if (supports_video)
+        {
+            keyframe_index.Save();
+        }
+    }
+
+    conversion_pool.Stop();
+    video_scalers.clear();
+
+    if (swr_resampler_ctx)
+    {
+        swr_free(&swr_resampler_ctx);
+        swr_resampler_ctx = nullptr;
+    }
+
+    resampled_audio.Clear();
+    audio_read_pts = 0;
+    ResetAudioDrift();
+
+    {
+        const std::unique_lock lock(stream_descriptions_mtx);
+        stream_descriptions.clear();
+    }
+
+    described_stream_count = 0;
+
+    if (av_format_ctx)
+    {
+        avformat_close_input(&av_format_ctx);
+        avformat_free_context(av_format_ctx);
+        av_format_ctx = nullptr;
+    }
+
+    if (audio_stream.codec_ctx)
+    {
+        avcodec_free_context(&audio_stream.codec_ctx);
+        audio_stream.codec_ctx = nullptr;
+    }
+
+    if (video_stream.codec_ctx)
+    {
+        avcodec_free_context(&video_stream.codec_ctx);
+        video_stream.codec_ctx = nullptr;
+    }
+}
+
+bool Simulacrum::AV::Core::VideoReader::InitializeVideoDecoder(
+    const AVCodecParameters& codec_params,
+    const AVCodec& codec)
+{
+    const auto requested_lowres = std::clamp(options.lowres, 0, 3);
+    lowres = min(requested_lowres, static_cast<int>(codec.max_lowres));
+    if (lowres < requested_lowres)
+    {
+        av_log(nullptr, AV_LOG_INFO, "[user] Decoder %s only supports lowres up to %d", codec.name, codec.max_lowres);
+    }
+
+    const auto decoder_thread_count = GetThreadCount(options.decoder_thread_count, max_auto_decoder_threads);
+    if (!InitializeCodecContext(video_stream.codec_ctx, codec_params, codec, decoder_thread_count,
+                                options.decoder_thread_type, lowres))
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not initialize video decoder context");
+        return false;
+    }
+
+    if (lowres > 0)
+    {
+        // Lowres decoding shrinks every frame by a power of two, so the default output size shrinks with it
+        source_width = AV_CEIL_RSHIFT(codec_params.width, lowres);
+        source_height = AV_CEIL_RSHIFT(codec_params.height, lowres);
+        fit_output_size(source_width, source_height, requested_output_width, requested_output_height, width,
+                        height);
+    }
+
+    // Each conversion thread scales its bands with its own swscale context
+    const auto conversion_thread_count = GetThreadCount(options.conversion_thread_count, max_auto_conversion_threads);
+    conversion_pool.Start(conversion_thread_count);
+    for (auto i = 0; i < conversion_thread_count; i++)
+    {
+        video_scalers.push_back(std::make_unique<VideoScaler>());
+    }
+
+    if (!options.disable_simd_conversion)
+    {
+        av_log(nullptr, AV_LOG_VERBOSE, "[user] SIMD color conversion instruction set: %s", GetColorConvertIsa());
+    }
+
+    return true;
+}
+
+bool Simulacrum::AV::Core::VideoReader::FindDecoder(
+    const int stream_index,
+    const AVCodecParameters*& codec_params,
+    const AVCodec*& codec) const
+{
+    const auto* found_codec_params = av_format_ctx->streams[stream_index]->codecpar;
+    const auto* found_codec = avcodec_find_decoder(found_codec_params->codec_id);
+    if (!found_codec)
+    {
+        return false;
+    }
+
+    codec_params = found_codec_params;
+    codec = found_codec;
+
+    return true;
+}
+
+bool Simulacrum::AV::Core::VideoReader::InitializeCodecContext(
+    AVCodecContext*& codec_ctx,
+    const AVCodecParameters& codec_params,
+    const AVCodec& codec,
+    const int thread_count,
+    const int thread_type,
+    const int lowres)
+{
+    codec_ctx = avcodec_alloc_context3(&codec);
+    if (!codec_ctx)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not allocate decoder context");
+        return false;
+    }
+
+    if (avcodec_parameters_to_context(codec_ctx, &codec_params) < 0)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not copy decoder context");
+        return false;
+    }
+
+    codec_ctx->thread_count = thread_count;
+    codec_ctx->lowres = lowres;
+    if (thread_type != 0)
+    {
+        codec_ctx->thread_type = thread_type;
+    }
+
+    if (avcodec_open2(codec_ctx, &codec, nullptr) < 0)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not open decoder");
+        return false;
+    }
+
+    return true;
+}
+
+bool Simulacrum::AV::Core::VideoReader::ReopenDecoder(StreamInfo& stream)
+{
+    const auto* file_stream = av_format_ctx->streams[stream.stream_index];
+    const auto* codec = avcodec_find_decoder(file_stream->codecpar->codec_id);
+    if (!codec)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not find decoder for stream %d", file_stream->index);
+        return false;
+    }
+
+    const auto is_video = &stream == &video_stream;
+    const auto stream_lowres = is_video
+                                   ? min(std::clamp(options.lowres, 0, 3), static_cast<int>(codec->max_lowres))
+                                   : 0;
+    const auto thread_count = is_video ? GetThreadCount(options.decoder_thread_count, max_auto_decoder_threads) : 1;
+    AVCodecContext* codec_ctx = nullptr;
+    if (!InitializeCodecContext(codec_ctx, *file_stream->codecpar, *codec, thread_count,
+                                is_video ? options.decoder_thread_type : 0, stream_lowres))
+    {
+        // Keep the old decoder; it will reject the new stream's packets, but at least it won't crash on them
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not initialize decoder context for stream %d", file_stream->index);
+        avcodec_free_context(&codec_ctx);
+        return false;
+    }
+
+    avcodec_free_context(&stream.codec_ctx);
+    stream.codec_ctx = codec_ctx;
+    stream.time_base = file_stream->time_base;
+    stream.draining = false;
+    stream.catching_up = false;
+    stream.decimating = false;
+    if (is_video)
+    {
+        lowres = stream_lowres;
+    }
+
+    return true;
+}
+
+int Simulacrum::AV::Core::VideoReader::GetThreadCount(const int configured_count, const int max_auto_count) const
+{
+    if (configured_count > 0)
+    {
+        return configured_count;
+    }
+
+    // Split the machine's cores between every reader that is currently open, including this one while
+    // it is still being opened
+    const auto core_count = static_cast<int>(std::thread::hardware_concurrency());
+    const auto reader_count = max(active_reader_count.load() + (active ? 0 : 1), 1);
+    return std::clamp(core_count / reader_count, 1, max_auto_count);
+}
+
+bool Simulacrum::AV::Core::VideoReader::HandleFlushRequest(StreamInfo& stream)
+{
+    if (!stream.flush_requested.exchange(false))
+    {
+        return false;
+    }
+
+    // A new decoder starts out flushed, so only flush the current one if it's staying
+    if (!stream.reopen_requested.exchange(false) || !ReopenDecoder(stream))
+    {
+        avcodec_flush_buffers(stream.codec_ctx);
+    }
+
+    stream.draining = false;
+    return true;
+}
+
+bool Simulacrum::AV::Core::VideoReader::IsFlushPending(StreamInfo& stream) const
+{
+    // A seek that the ingest thread hasn't picked up yet will flush the stream too
+    if (stream.seek_requested || stream.flush_requested)
+    {
+        return true;
+    }
+
+    // In pipelined mode, the decode thread handles the flush request and then flushes its frame queue
+    return stream.frame_queue && stream.frame_queue->Serial() != stream.frame_serial;
+}
+
+bool Simulacrum::AV::Core::VideoReader::DecodeVideoFrameAt(const double& target_pts, double& pts)
+{
+    if (!supports_video)
+    {
+        return false;
+    }
+
+    // A seek makes the current frame stale, even if the decoder fails to produce a new one right away
+    if (IsFlushPending(video_stream))
+    {
+        video_frame_stale = true;
+    }
+
+    // Under a frame rate cap, nothing before the next presentation time will be shown
+    const auto max_frame_rate = requested_max_frame_rate.load();
+    auto next_pts = target_pts;
+    if (max_frame_rate > 0 && video_output_generation > 0 && !video_frame_stale)
+    {
+        next_pts = std::max<double>(target_pts, video_output_pts + 1.0 / max_frame_rate);
+    }
+
+    // Let the decoder know how far ahead we're trying to get, so it can skip work on frames we'll drop
+    video_stream.catch_up_pts = next_pts;
+
+    // The current frame is still the one to show if the target hasn't moved past it or the next frame isn't due yet
+    if (video_frame_generation > 0 && !video_frame_stale)
+    {
+        pts = pts_to_seconds(video_stream.current_frame->best_effort_timestamp, video_stream.current_frame->time_base);
+        if (pts >= target_pts || next_pts > target_pts)
+        {
+            return true;
+        }
+    }
+
+    do
+    {
+        if (!DecodeVideoFrame())
+        {
+            return false;
+        }
+
+        video_frame_generation++;
+        video_frame_stale = false;
+
+        const auto best_effort_timestamp = video_stream.current_frame->best_effort_timestamp;
+
+        pts = pts_to_seconds(best_effort_timestamp, video_stream.current_frame->time_base);
+
+        const auto pts_diff = best_effort_timestamp - video_last_frame_timestamp;
+        video_frame_delay = pts_to_seconds(pts_diff, video_stream.current_frame->time_base);
+
+        video_last_frame_timestamp = best_effort_timestamp;
+    }
+    while (pts < target_pts);
+
+    return true;
+}
+
+bool Simulacrum::AV::Core::VideoReader::IsVideoOutputStale() const
+{
+    return video_output_generation != video_frame_generation || output_changed;
+}
+
+void Simulacrum::AV::Core::VideoReader::UpdateCatchUpMode(StreamInfo& stream, const AVPacket& packet) const
+{
+    auto catching_up = false;
+    auto decimating = false;
+    if (const auto packet_ts = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts; packet_ts != AV_NOPTS_VALUE)
+    {
+        const auto packet_pts = pts_to_seconds(packet_ts, stream.time_base);
+        catching_up = !options.disable_catch_up_decoding && packet_pts + catch_up_threshold < stream.catch_up_pts;
+
+        // Frames that fall between presented frames are never shown, so they only matter as references
+        decimating = &stream == &video_stream && requested_max_frame_rate > 0 && packet_pts < stream.catch_up_pts;
+    }
+
+    if (catching_up == stream.catching_up && decimating == stream.decimating)
+    {
+        return;
+    }
+
+    // Skipping the loop filter degrades reference frames too, but only until the next keyframe, and
+    // frames close to the target are always decoded at full quality
+    stream.codec_ctx->skip_frame = catching_up || decimating ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    stream.codec_ctx->skip_loop_filter = catching_up ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    stream.catching_up = catching_up;
+    stream.decimating = decimating;
+}
+
+bool Simulacrum::AV::Core::VideoReader::DecodeFrame(StreamInfo& stream, AVFrame* frame)
+{
+    while (true)
+    {
+        // Return any frames the decoder has already buffered before feeding it more data
+        auto result = avcodec_receive_frame(stream.codec_ctx, frame);
+        if (result >= 0)
+        {
+            // The stream may be switched while this frame is still queued, so the frame carries its own time base
+            frame->time_base = stream.time_base;
+            return true;
+        }
+
+        if (result == AVERROR_EOF)
+        {
+            // The decoder has been fully drained; only a seek can give us more frames now
+            return false;
+        }
+
+        if (result != AVERROR(EAGAIN))
+        {
+            av_log(nullptr, AV_LOG_ERROR, "[user] Error decoding frame: %s", av_make_error(result));
+            return false;
+        }
+
+        if (stream.draining)
+        {
+            // The decoder is waiting on a drain that has nothing left in it
+            return false;
+        }
+
+        // The decoder needs more input
+        AVPacket* next_packet;
+        if (!stream.packet_queue->Pop(next_packet))
+        {
+            if (!stream.end_of_stream)
+            {
+                // Let the ingest thread know that we need more data
+                RequestIngest(stream);
+                return false;
+            }
+
+            // Check the queue again after seeing the end-of-stream flag, since the last packets are
+            // pushed before it is set
+            if (!stream.packet_queue->Pop(next_packet))
+            {
+                // Enter draining mode, so that the decoder gives us whatever frames it's still holding onto
+                stream.draining = true;
+                avcodec_send_packet(stream.codec_ctx, nullptr);
+                continue;
+            }
+        }
+
+        UpdateCatchUpMode(stream, *next_packet);
+
+        // The decoder takes its own reference to the packet data, so the packet can go straight back to the pool
+        result = avcodec_send_packet(stream.codec_ctx, next_packet);
+        packet_pool.Release(next_packet);
+        if (result < 0)
+        {
+            // Skip over the bad packet and try the next one
+            av_log(nullptr, AV_LOG_ERROR, "[user] Error submitting packet for decoding: %s", av_make_error(result));
+        }
+    }
+}
+
+bool Simulacrum::AV::Core::VideoReader::ReceiveFrame(StreamInfo& stream)
+{
+    if (stream.seek_requested)
+    {
+        // Everything that could be decoded right now is from before the seek
+        return false;
+    }
+
+    if (stream.frame_queue)
+    {
+        if (stream.flush_requested)
+        {
+            // The decode thread hasn't caught up with the last seek yet; it flushes the frame queue before it
+            // clears the request, so nothing from before the seek can be popped once this is clear
+            return false;
+        }
+
+        return stream.frame_queue->Pop(stream.current_frame, stream.frame_serial);
+    }
+
+    HandleFlushRequest(stream);
+    return DecodeFrame(stream, stream.current_frame);
+}
+
+bool Simulacrum::AV::Core::VideoReader::DecodeAudioFrame()
+{
+    if (!ReceiveFrame(audio_stream))
+    {
+        return false;
+    }
+
+    // Initialize the resampler if needed, now that some data has been decoded into the codec context
+    if (!swr_resampler_ctx && !InitializeAudioResampler())
+    {
+        return false;
+    }
+
+    // The first output sample is the oldest one still held back in the resampler, not the first one of this frame
+    const auto frame_pts = pts_to_seconds(audio_stream.current_frame->best_effort_timestamp,
+                                          audio_stream.current_frame->time_base);
+    const auto pts = frame_pts - static_cast<double>(swr_get_delay(swr_resampler_ctx, sample_rate)) / sample_rate;
+
+    CompensateAudioDrift(pts);
+
+    const auto max_samples = swr_get_out_samples(swr_resampler_ctx, audio_stream.current_frame->nb_samples);
+    const auto max_size = av_samples_get_buffer_size(nullptr, audio_channel_count, max_samples,
+                                                     static_cast<AVSampleFormat>(sample_format), 1);
+    if (max_samples < 0 || max_size < 0)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not get required audio buffer size");
+        return false;
+    }
+
+    // Resample the audio into our expected format, straight into the buffer
+    int sample_count;
+    if (!CopyResampledAudio(resampled_audio.BeginWrite(max_size), max_samples, sample_count))
+    {
+        return false;
+    }
+
+    resampled_audio.EndWrite(static_cast<size_t>(sample_count) * audio_channel_count * (bits_per_sample / 8), pts);
+
+    return true;
+}
+
+bool Simulacrum::AV::Core::VideoReader::DecodeVideoFrame()
+{
+    return ReceiveFrame(video_stream);
+}
+
+void Simulacrum::AV::Core::VideoReader::DecodeLoop(StreamInfo& stream)
+{
+    auto* frame = av_frame_alloc();
+    if (!frame)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not allocate frame");
+        return;
+    }
+
+    while (!done)
+    {
+        if (stream.flush_requested)
+        {
+            // Anything decoded before the flush is stale now. Drop it before clearing the request, since the
+            // reader goes back to popping frames as soon as it sees the request handled.
+            stream.frame_queue->Flush();
+            HandleFlushRequest(stream);
+        }
+
+        if (!stream.frame_queue->WaitForSpace())
+        {
+            // Woken up for a flush or for shutdown
+            continue;
+        }
+
+        if (!DecodeFrame(stream, frame))
+        {
+            // Park until the ingest thread gives us more packets, unless a flush or shutdown came in while
+            // we were decoding
+            if (!done && !stream.flush_requested)
+            {
+                stream.packet_queue->WaitForData();
+            }
+
+            continue;
+        }
+
+        stream.frame_queue->Push(frame);
+    }
+
+    av_frame_free(&frame);
+}
+
+void Simulacrum::AV::Core::VideoReader::StartDecodeThread(StreamInfo& stream, const int queue_size)
+{
+    stream.frame_queue = new FrameQueue(queue_size);
+    stream.frame_serial = stream.frame_queue->Serial();
+    stream.decode_thread = std::thread(&VideoReader::DecodeLoop, this, std::ref(stream));
+}
+
+void Simulacrum::AV::Core::VideoReader::WakeDecoder(const StreamInfo& stream)
+{
+    if (stream.frame_queue)
+    {
+        stream.frame_queue->Wake();
+    }
+
+    stream.packet_queue->WakeConsumer();
+}
+
+int Simulacrum::AV::Core::VideoReader::SeekAudioFrameInternal()
+{
+    const auto time_base = av_format_ctx->streams[audio_stream.stream_index]->time_base;
+    const auto audio_seek_frame = static_cast<int64_t>(audio_stream.seek_pts / av_q2d(time_base));
+    const auto result = av_seek_frame(av_format_ctx, audio_stream.stream_index, audio_seek_frame,
+                                      audio_stream.seek_flags);
+    if (result < 0)
     {
         return result;
     }
 
     audio_stream.packet_queue->Flush();
     audio_stream.flush_requested = true;
+    WakeDecoder(audio_stream);
 
     return result;
 }
 
 int Simulacrum::AV::Core::VideoReader::SeekVideoFrameInternal()
 {
-    const auto video_seek_frame = static_cast<int64_t>(video_stream.seek_pts / av_q2d(video_stream.time_base));
-    const auto result = av_seek_frame(av_format_ctx, video_stream.stream_index, video_seek_frame,
-                                      video_stream.seek_flags);
+    const auto time_base = av_format_ctx->streams[video_stream.stream_index]->time_base;
+    auto video_seek_frame = static_cast<int64_t>(video_stream.seek_pts / av_q2d(time_base));
+    auto seek_flags = video_stream.seek_flags;
+
+    // The keyframe index only covers the video stream that was selected when the file was opened
+    if (int64_t keyframe_pts; video_stream.stream_index == indexed_stream_index &&
+        keyframe_index.FindPreceding(video_seek_frame, keyframe_pts))
+    {
+        // We know exactly where the closest keyframe is, so go straight there
+        video_seek_frame = keyframe_pts;
+        seek_flags = AVSEEK_FLAG_BACKWARD;
+    }
+
+    const auto result = av_seek_frame(av_format_ctx, video_stream.stream_index, video_seek_frame, seek_flags);
     if (result < 0)
     {
         return result;
@@ -478,17 +1354,65 @@ int Simulacrum::AV::Core::VideoReader::SeekVideoFrameInternal()
 
     video_stream.packet_queue->Flush();
     video_stream.flush_requested = true;
+    WakeDecoder(video_stream);
 
     return result;
 }
 
-bool Simulacrum::AV::Core::VideoReader::CopyResampledAudio(uint8_t* audio_buffer, int& samples_read) const
+void Simulacrum::AV::Core::VideoReader::UpdateStreamDescriptions()
+{
+    const auto stream_count = static_cast<int>(av_format_ctx->nb_streams);
+    std::vector<MediaStreamInfo> descriptions;
+    descriptions.reserve(stream_count);
+    for (auto i = 0; i < stream_count; i++)
+    {
+        auto* stream = av_format_ctx->streams[i];
+
+        // Have the demuxer drop packets of every other stream, so they're never read into packets, let alone
+        // queued; streams we've seen before may have been selected since, so leave them alone
+        if (i >= described_stream_count && i != audio_stream.stream_index && i != video_stream.stream_index)
+        {
+            stream->discard = AVDISCARD_ALL;
+        }
+
+        descriptions.push_back(describe_stream(stream, i));
+    }
+
+    described_stream_count = stream_count;
+
+    const std::unique_lock lock(stream_descriptions_mtx);
+    stream_descriptions = std::move(descriptions);
+}
+
+void Simulacrum::AV::Core::VideoReader::SwitchStreamInternal(StreamInfo& stream, const int stream_index)
+{
+    if (stream_index == stream.stream_index)
+    {
+        return;
+    }
+
+    av_format_ctx->streams[stream.stream_index]->discard = AVDISCARD_ALL;
+    av_format_ctx->streams[stream_index]->discard = AVDISCARD_DEFAULT;
+    stream.stream_index = stream_index;
+
+    // Nothing queued from the old stream can be decoded by the new decoder
+    stream.packet_queue->Flush();
+    stream.packet_queue->SetTimeBase(av_format_ctx->streams[stream_index]->time_base);
+    stream.reopen_requested = true;
+    stream.flush_requested = true;
+    WakeDecoder(stream);
+}
+
+bool Simulacrum::AV::Core::VideoReader::CopyResampledAudio(
+    uint8_t* audio_buffer,
+    const int max_samples,
+    int& samples_read) const
 {
     // Resample the audio into our expected format
     uint8_t* out_data[8] = {audio_buffer, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
-    const auto sample_count = swr_convert(swr_resampler_ctx, out_data, audio_stream.current_frame.nb_samples,
-                                          const_cast<const uint8_t**>(audio_stream.current_frame.data),
-                                          audio_stream.current_frame.nb_samples);
+    const auto sample_count = swr_convert(swr_resampler_ctx, out_data, max_samples,
+                                          const_cast<const uint8_t**>(audio_stream.current_frame->data),
+                                          audio_stream.current_frame->nb_samples);
     if (sample_count < 0)
     {
         av_log(nullptr, AV_LOG_ERROR, "[user] Could not resample audio samples");
@@ -500,14 +1424,84 @@ bool Simulacrum::AV::Core::VideoReader::CopyResampledAudio(uint8_t* audio_buffer
     return true;
 }
 
-void Simulacrum::AV::Core::VideoReader::CopyScaledVideo(uint8_t* frame_buffer) const
+void Simulacrum::AV::Core::VideoReader::CompensateAudioDrift(const double pts)
+{
+    const auto* frame = audio_stream.current_frame;
+    const auto frame_samples = static_cast<int>(av_rescale(frame->nb_samples, sample_rate, frame->sample_rate));
+    if (frame_samples <= 0)
+    {
+        return;
+    }
+
+    int compensation;
+    {
+        const std::unique_lock lock(audio_sync_mtx);
+        if (std::abs(audio_clock_drift) < audio_sync_threshold)
+        {
+            return;
+        }
+
+        // Stretch audio that is ahead of the clock and squeeze audio that is behind it, a little at a time
+        const auto max_compensation = static_cast<int>(frame_samples * max_audio_compensation);
+        compensation = std::clamp(static_cast<int>(std::lround(audio_clock_drift * sample_rate)), -max_compensation,
+                                  max_compensation);
+        if (compensation == 0)
+        {
+            return;
+        }
+
+        const auto duration = static_cast<double>(compensation) / sample_rate;
+        audio_clock_drift -= duration;
+        audio_corrections.push_back(
+            AudioCorrection{pts + static_cast<double>(frame_samples + compensation) / sample_rate, duration});
+    }
+
+    // This switches the resampler into resampling mode the first time it is used, which costs nothing if the input
+    // and output rates match, since nothing is being held back yet
+    if (const auto result = swr_set_compensation(swr_resampler_ctx, compensation, frame_samples + compensation);
+        result < 0)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not set audio compensation: %s", av_make_error(result));
+    }
+}
+
+void Simulacrum::AV::Core::VideoReader::ResetAudioDrift()
+{
+    const std::unique_lock lock(audio_sync_mtx);
+    audio_corrections.clear();
+    audio_clock_drift = 0;
+}
+
+bool Simulacrum::AV::Core::VideoReader::CopyScaledVideo(uint8_t* frame_buffer, const int stride)
 {
-    uint8_t* dest[4] = {frame_buffer, nullptr, nullptr, nullptr};
-    const int dest_linesize[4] = {width * 4, 0, 0, 0};
+    // Unscaled frames in common formats can skip swscale entirely
+    const auto* frame = video_stream.current_frame;
+    const auto use_simd = !options.disable_simd_conversion && frame->width == width && frame->height == height &&
+        CanConvertToBgra(frame);
+
+    // Split the frame into one band per thread, keeping band boundaries on whole chroma rows for the SIMD
+    // converters and on whole slices for swscale
+    const auto alignment = use_simd ? 2 : video_scalers[0]->RowAlignment();
+    const auto max_bands = std::clamp(height / min_conversion_band_rows, 1, conversion_pool.ThreadCount());
+    const auto band_rows = ((height + max_bands - 1) / max_bands + alignment - 1) / alignment * alignment;
+    const auto band_count = (height + band_rows - 1) / band_rows;
+
+    std::atomic<bool> succeeded = true;
+    conversion_pool.Run(band_count, [&](const int band)
+    {
+        const auto row_start = band * band_rows;
+        const auto row_count = min(band_rows, height - row_start);
+        if (use_simd)
+        {
+            ConvertToBgra(frame, frame_buffer, stride, row_start, row_count);
+        }
+        else if (!video_scalers[band]->Scale(frame, frame_buffer, stride, row_start, row_count))
+        {
+            succeeded = false;
+        }
+    });
 
-    // Rescale the frame into our expected format
-    sws_scale(sws_scaler_ctx, video_stream.current_frame.data, video_stream.current_frame.linesize, 0,
-              video_stream.current_frame.height, dest, dest_linesize);
+    return succeeded;
 }
 
 bool Simulacrum::AV::Core::VideoReader::InitializeAudioResampler()
@@ -521,9 +1515,10 @@ bool Simulacrum::AV::Core::VideoReader::InitializeAudioResampler()
 
     AVChannelLayout out_ch_layout;
     av_channel_layout_default(&out_ch_layout, audio_channel_count);
-    swr_alloc_set_opts2(&swr_resampler_ctx, &out_ch_layout, out_sample_format, sample_rate,
-                        &audio_stream.codec_ctx->ch_layout, audio_stream.codec_ctx->sample_fmt,
-                        audio_stream.codec_ctx->sample_rate, audio_stream.codec_ctx->log_level_offset, nullptr);
+    swr_alloc_set_opts2(&swr_resampler_ctx, &out_ch_layout, static_cast<AVSampleFormat>(sample_format),
+                        sample_rate, &audio_stream.current_frame->ch_layout,
+                        static_cast<AVSampleFormat>(audio_stream.current_frame->format),
+                        audio_stream.current_frame->sample_rate, 0, nullptr);
     swr_init(swr_resampler_ctx);
 
     if (!swr_is_initialized(swr_resampler_ctx))
@@ -535,30 +1530,147 @@ bool Simulacrum::AV::Core::VideoReader::InitializeAudioResampler()
     return true;
 }
 
-bool Simulacrum::AV::Core::VideoReader::InitializeVideoScaler()
+bool Simulacrum::AV::Core::VideoReader::InitializeVideoScaler(bool& size_changed)
 {
-    const auto source_pix_fmt = correct_for_deprecated_pixel_format(video_stream.codec_ctx->pix_fmt);
-    sws_scaler_ctx = sws_getContext(width, height, source_pix_fmt,
-                                    width, height, AV_PIX_FMT_BGRA,
-                                    SWS_BILINEAR, nullptr, nullptr, nullptr);
-    if (!sws_scaler_ctx)
+    size_changed = false;
+
+    // Adaptive streams and some files switch resolution or pixel format mid-stream, so check every frame
+    const auto* frame = video_stream.current_frame;
+    const auto source_changed = frame->width != source_width || frame->height != source_height ||
+        frame->format != video_source_format;
+    if (video_scalers[0]->IsConfigured() && !output_changed && !source_changed)
     {
-        av_log(nullptr, AV_LOG_ERROR, "[user] Could not allocate sws context");
-        return false;
+        return true;
+    }
+
+    const auto source_pix_fmt = correct_for_deprecated_pixel_format(static_cast<AVPixelFormat>(frame->format));
+    const auto previous_width = width;
+    const auto previous_height = height;
+    int scaler_flags;
+    {
+        const std::unique_lock lock(output_mtx);
+        output_changed = false;
+        source_width = frame->width;
+        source_height = frame->height;
+        fit_output_size(source_width, source_height, requested_output_width, requested_output_height, width, height);
+        scaler_flags = requested_scaler_flags ? requested_scaler_flags : default_scaler_flags;
+    }
+
+    video_source_format = frame->format;
+    size_changed = width != previous_width || height != previous_height;
+
+    for (const auto& scaler : video_scalers)
+    {
+        if (!scaler->Configure(source_width, source_height, source_pix_fmt, width, height, scaler_flags))
+        {
+            return false;
+        }
     }
 
     return true;
 }
 
+void Simulacrum::AV::Core::VideoReader::WakeIngest()
+{
+    {
+        // Take the lock so the notification can't slip in between the ingest thread checking
+        // its wait condition and going to sleep
+        const std::unique_lock lock(ingest_mtx);
+    }
+
+    ingest_cv.notify_one();
+    audio_stream.packet_queue->WakeProducer();
+    video_stream.packet_queue->WakeProducer();
+}
+
+void Simulacrum::AV::Core::VideoReader::RequestIngest(StreamInfo& stream)
+{
+    {
+        const std::unique_lock lock(ingest_mtx);
+        if (stream.ingest_demand)
+        {
+            // The ingest thread already knows
+            return;
+        }
+
+        stream.ingest_demand = true;
+    }
+
+    ingest_cv.notify_one();
+
+    // The ingest thread may be stuck waiting for space in the other stream's queue
+    (&stream == &audio_stream ? video_stream : audio_stream).packet_queue->WakeProducer();
+}
+
+bool Simulacrum::AV::Core::VideoReader::WaitForIngest()
+{
+    std::unique_lock lock(ingest_mtx);
+    ingest_cv.wait(lock, [this]
+    {
+        return done || audio_stream.seek_requested || video_stream.seek_requested || audio_stream.ingest_demand
+            || video_stream.ingest_demand || !paused && !ingest_stalled;
+    });
+
+    if (audio_stream.ingest_demand || video_stream.ingest_demand)
+    {
+        // A decoder ran dry, so try reading again even if we had reached the end of the file
+        ingest_stalled = false;
+    }
+
+    return !done;
+}
+
+void Simulacrum::AV::Core::VideoReader::WaitForIngestRetry(const int delay_ms)
+{
+    std::unique_lock lock(ingest_mtx);
+    ingest_cv.wait_for(lock, std::chrono::milliseconds(delay_ms), [this]
+    {
+        return done || audio_stream.seek_requested || video_stream.seek_requested;
+    });
+}
+
+bool Simulacrum::AV::Core::VideoReader::EnqueuePacket(const StreamInfo& stream, AVPacket* packet) const
+{
+    const auto& other_stream = &stream == &audio_stream ? video_stream : audio_stream;
+    while (true)
+    {
+        if (other_stream.ingest_demand)
+        {
+            // Don't hold up the other stream waiting on this one, whose consumer may be slow or not reading at all
+            if (stream.packet_queue->PushOverLimit(packet))
+            {
+                return true;
+            }
+
+            av_log(nullptr, AV_LOG_VERBOSE, "[user] Dropping packet for stream %d, its queue is full",
+                   stream.stream_index.load());
+            return false;
+        }
+
+        if (stream.packet_queue->Push(packet))
+        {
+            return true;
+        }
+
+        // We were woken up while waiting for space in the queue; if that was for a seek or for
+        // shutdown, the packet is stale and should be dropped
+        if (done || audio_stream.seek_requested || video_stream.seek_requested)
+        {
+            return false;
+        }
+    }
+}
+
 void Simulacrum::AV::Core::VideoReader::Ingest()
 {
     AVPacket* packet = nullptr;
+    auto retry_delay_ms = min_ingest_retry_delay_ms;
 
     while (!done)
     {
         if (!packet)
         {
-            packet = av_packet_alloc();
+            packet = packet_pool.Acquire();
             if (!packet)
             {
                 av_log(nullptr, AV_LOG_ERROR, "[user] Could not allocate packet");
@@ -566,41 +1678,137 @@ void Simulacrum::AV::Core::VideoReader::Ingest()
             }
         }
 
-        if (audio_stream.seek_requested)
+        // Park until we have a reason to read more data
+        if (!WaitForIngest())
+        {
+            break;
+        }
+
+        // Stream switches go first, so that the seeks requested along with them land on the new streams
+        for (auto* stream : {&audio_stream, &video_stream})
+        {
+            if (const auto stream_index = stream->switch_stream_index.exchange(-1); stream_index != -1)
+            {
+                SwitchStreamInternal(*stream, stream_index);
+            }
+        }
+
+        // Start flushing a stream before taking its seek request, so that the reader always sees one or the other
+        // pending and never goes back to data from before the seek in between
+        for (auto* stream : {&audio_stream, &video_stream})
+        {
+            if (stream->seek_requested)
+            {
+                stream->packet_queue->Flush();
+                stream->flush_requested = true;
+            }
+        }
+
+        auto seeked = false;
+        if (audio_stream.seek_requested.exchange(false))
         {
             if (const auto result = SeekAudioFrameInternal(); result < 0)
             {
                 av_log(nullptr, AV_LOG_ERROR, "[user] Could not seek audio stream: %s", av_make_error(result));
             }
 
-            audio_stream.seek_requested = false;
+            seeked = true;
         }
 
-        if (video_stream.seek_requested)
+        if (video_stream.seek_requested.exchange(false))
         {
             if (const auto result = SeekVideoFrameInternal(); result < 0)
             {
                 av_log(nullptr, AV_LOG_ERROR, "[user] Could not seek video stream: %s", av_make_error(result));
             }
 
-            video_stream.seek_requested = false;
+            seeked = true;
         }
 
-        if (av_read_frame(av_format_ctx, packet) < 0)
+        if (seeked)
+        {
+            // Seeking may have moved us away from the end of the file
+            if (supports_video)
+            {
+                keyframe_index.BreakRun();
+            }
+
+            audio_stream.end_of_stream = false;
+            video_stream.end_of_stream = false;
+
+            const std::unique_lock lock(ingest_mtx);
+            ingest_stalled = false;
+        }
+
+        if (const auto result = av_read_frame(av_format_ctx, packet); result == AVERROR_EOF)
+        {
+            if (!video_stream.end_of_stream)
+            {
+                if (supports_video)
+                {
+                    keyframe_index.MarkEnd();
+                }
+
+                // Let the decoders drain the frames they're still holding onto
+                audio_stream.end_of_stream = true;
+                video_stream.end_of_stream = true;
+                WakeDecoder(audio_stream);
+                WakeDecoder(video_stream);
+            }
+
+            // No more packets to read, but seeking could change that
+            const std::unique_lock lock(ingest_mtx);
+            ingest_stalled = true;
+            audio_stream.ingest_demand = false;
+            video_stream.ingest_demand = false;
+            continue;
+        }
+        else if (result < 0)
         {
-            // No more packets to read right now, but seeking could change that
+            av_log(nullptr, AV_LOG_WARNING, "[user] Could not read packet, retrying in %dms: %s", retry_delay_ms,
+                   av_make_error(result));
+            WaitForIngestRetry(retry_delay_ms);
+            retry_delay_ms = min(retry_delay_ms * 2, max_ingest_retry_delay_ms);
             continue;
         }
 
+        retry_delay_ms = min_ingest_retry_delay_ms;
+
+        if (static_cast<int>(av_format_ctx->nb_streams) != described_stream_count)
+        {
+            // Some formats, like HLS and MPEG-TS, can add streams while they're being read
+            UpdateStreamDescriptions();
+        }
+
         if (packet->stream_index == video_stream.stream_index)
         {
-            video_stream.packet_queue->Push(packet);
-            packet = nullptr;
+            if (packet->flags & AV_PKT_FLAG_KEY && packet->stream_index == indexed_stream_index)
+            {
+                keyframe_index.Add(packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts, packet->pos);
+            }
+
+            if (EnqueuePacket(video_stream, packet))
+            {
+                // The decoder has something to work with again
+                video_stream.ingest_demand = false;
+                packet = nullptr;
+            }
+            else
+            {
+                av_packet_unref(packet);
+            }
         }
         else if (packet->stream_index == audio_stream.stream_index)
         {
-            audio_stream.packet_queue->Push(packet);
-            packet = nullptr;
+            if (EnqueuePacket(audio_stream, packet))
+            {
+                audio_stream.ingest_demand = false;
+                packet = nullptr;
+            }
+            else
+            {
+                av_packet_unref(packet);
+            }
         }
         else
         {
@@ -608,6 +1816,6 @@ void Simulacrum::AV::Core::VideoReader::Ingest()
         }
     }
 
-    // Free the packet if it hasn't already been freed
-    av_packet_free(&packet);
+    // Return the packet if it hasn't already been queued
+    packet_pool.Release(packet);
 }
@@ -1,5 +1,19 @@
 ﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "AudioBuffer.h"
+#include "ColorConvert.h"
+#include "FrameQueue.h"
+#include "FrameRing.h"
+#include "KeyframeIndex.h"
+#include "PacketPool.h"
 #include "PacketQueue.h"
+#include "VideoScaler.h"
+#include "WorkerPool.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -12,12 +26,220 @@ extern "C" {
 
 namespace Simulacrum::AV::Core
 {
+    /**
+     * \brief Options for opening a video. Zero-initialized options select the default behavior.
+     */
+    struct VideoReaderOptions
+    {
+        /**
+         * \brief Nonzero to decode each stream on a dedicated thread ahead of the reader.
+         */
+        int pipelined_decoding;
+
+        /**
+         * \brief The number of decoded video frames to buffer in pipelined mode, or 0 for the default.
+         */
+        int video_frame_queue_size;
+
+        /**
+         * \brief The number of decoded audio frames to buffer in pipelined mode, or 0 for the default.
+         */
+        int audio_frame_queue_size;
+
+        /**
+         * \brief The number of threads to decode video with, or 0 to size this automatically from the
+         * number of cores and the number of active readers.
+         */
+        int decoder_thread_count;
+
+        /**
+         * \brief The kind of multithreading to decode video with: FF_THREAD_FRAME, FF_THREAD_SLICE, or 0
+         * to let the decoder pick whichever it supports.
+         */
+        int decoder_thread_type;
+
+        /**
+         * \brief Nonzero to fully decode every frame on the way to a target timestamp, rather than skipping
+         * non-reference frames and the loop filter for frames that will never be shown.
+         */
+        int disable_catch_up_decoding;
+
+        /**
+         * \brief The width to scale video frames to, or 0 for the source width. If only one of the output
+         * width and height is set, the other is chosen to preserve the source aspect ratio.
+         */
+        int output_width;
+
+        /**
+         * \brief The height to scale video frames to, or 0 for the source height.
+         */
+        int output_height;
+
+        /**
+         * \brief The swscale flags (such as SWS_BILINEAR or SWS_AREA) to scale video frames with, or 0 for the default.
+         */
+        int scaler_flags;
+
+        /**
+         * \brief Nonzero to publish decoded YUV420P and NV12 frames as-is from PublishVideoFrame(), so that they
+         * can be converted on the GPU. Frames in other formats are still converted to BGRA. Published planar
+         * frames keep their decoded size; the output size only applies to converted frames.
+         */
+        int planar_output;
+
+        /**
+         * \brief Nonzero to always convert video frames with swscale, instead of using the built-in SIMD color
+         * converters for unscaled YUV420P and NV12 frames.
+         */
+        int disable_simd_conversion;
+
+        /**
+         * \brief The number of threads to convert each video frame with, or 0 to size this automatically from
+         * the number of cores and the number of active readers.
+         */
+        int conversion_thread_count;
+
+        /**
+         * \brief The maximum number of new video frames to present per second, or 0 for no limit. Frames in
+         * between are neither converted nor, where the codec allows it, fully decoded.
+         */
+        int max_frame_rate;
+
+        /**
+         * \brief Decodes video at a reduced size of 1/2, 1/4 or 1/8 with a value of 1, 2 or 3, which is much
+         * cheaper than decoding at full size and scaling down. This is limited to what the decoder supports, and
+         * ignored if it doesn't support lowres decoding at all.
+         */
+        int lowres;
+
+        /**
+         * \brief The duration of resampled audio to decode ahead of ReadAudioStream(), in milliseconds, or 0 for
+         * the default. Reads larger than this are still filled completely.
+         */
+        int audio_buffer_duration;
+
+        /**
+         * \brief The sample format to output audio in, either AV_SAMPLE_FMT_S16 or AV_SAMPLE_FMT_FLT, or 0 for
+         * AV_SAMPLE_FMT_S16.
+         */
+        int audio_sample_format;
+
+        /**
+         * \brief The sample rate to output audio at, or 0 for the source sample rate. Setting this to the rate of the
+         * output device saves the system mixer from resampling the audio a second time.
+         */
+        int audio_sample_rate;
+
+        /**
+         * \brief The number of channels to output audio in, using the default layout for that many channels, or 0
+         * for stereo. Sources with a different layout are mixed down or up as needed.
+         */
+        int audio_channel_count;
+
+        /**
+         * \brief Nonzero to open the video stream only, even if the file has audio. Audio packets are then discarded
+         * by the demuxer, and no audio decoder or resampler is created. Files without audio are always opened this
+         * way.
+         */
+        int disable_audio;
+
+        /**
+         * \brief Nonzero to open the audio stream only, even if the file has video. Video packets are then discarded
+         * by the demuxer, and no video decoder or scaler is created. Files without video are always opened this way.
+         */
+        int disable_video;
+    };
+
+    /**
+     * \brief A description of one of the streams in an open file.
+     */
+    struct MediaStreamInfo
+    {
+        /**
+         * \brief The index of the stream in the file, which can be passed to VideoReader::SelectStream().
+         */
+        int index;
+
+        /**
+         * \brief The kind of stream this is, as an AVMediaType.
+         */
+        int media_type;
+
+        /**
+         * \brief The codec of the stream, as an AVCodecID.
+         */
+        int codec_id;
+
+        /**
+         * \brief The short name of the codec of the stream.
+         */
+        char codec_name[32];
+
+        /**
+         * \brief The language of the stream as tagged in the file, usually an ISO 639 code, or empty if it isn't
+         * tagged.
+         */
+        char language[16];
+
+        /**
+         * \brief The bitrate of the stream in bits per second, or 0 if it is unknown.
+         */
+        int64_t bit_rate;
+
+        /**
+         * \brief The size of the frames of a video stream, or 0 for other streams.
+         */
+        int width, height;
+
+        /**
+         * \brief The sample rate and number of channels of an audio stream, or 0 for other streams.
+         */
+        int sample_rate, channel_count;
+
+        /**
+         * \brief Nonzero if the stream is currently being read, or has been selected to be read next.
+         */
+        int selected;
+    };
+
+    /**
+     * \brief The result of reading or publishing a video frame.
+     */
+    enum class VideoFrameStatus : int
+    {
+        /**
+         * \brief No frame could be read.
+         */
+        error = 0,
+
+        /**
+         * \brief A frame that had not been output before was read and written to the output.
+         */
+        new_frame = 1,
+
+        /**
+         * \brief The frame at the target timestamp is the one that was already output last time, so nothing
+         * was written to the output.
+         */
+        no_new_frame = 2,
+
+        /**
+         * \brief A new frame was read, but the output size has changed since the previous one, either because the
+         * source changed its resolution mid-stream or because a new output size was requested. ReadVideoFrame()
+         * leaves the buffer untouched so the caller can reallocate it and read again; PublishVideoFrame()
+         * publishes the frame at its new size.
+         */
+        size_changed = 3,
+    };
+
     class VideoReader
     {
     public:
-        int width, height, sample_rate, bits_per_sample, audio_channel_count;
+        int width, height, source_width, source_height, lowres, sample_rate, sample_format, bits_per_sample,
+            audio_channel_count;
         double video_frame_delay;
         bool supports_audio;
+        bool supports_video;
 
         VideoReader();
         ~VideoReader();
@@ -25,9 +247,10 @@ namespace Simulacrum::AV::Core
         /**
          * \brief Opens a video file. This may be a local file or a network object.
          * \param uri The URI of the file to open.
+         * \param options The options to open the file with.
          * \return `true` if the file was opened successfully; otherwise `false`.
          */
-        bool Open(const char* uri);
+        bool Open(const char* uri, const VideoReaderOptions& options = {});
 
         /**
          * \brief Reads data from the audio stream into the provided buffer.
@@ -39,13 +262,55 @@ namespace Simulacrum::AV::Core
         int ReadAudioStream(uint8_t* audio_buffer, int len, double& pts);
 
         /**
-         * \brief Reads a video frame from the file. This always reads at least one video frame.
+         * \brief Reads a video frame from the file. Frames are only decoded if the current frame is behind the
+         * target timestamp, and only converted if they have not been output already.
          * \param frame_buffer The buffer to read frame data into. It must have width * height * pixel_size elements.
          * \param target_pts The timestamp to read frame data at. This is a "best effort" parameter.
          * \param pts The timestamp of the actual frame that was read.
-         * \return `true` if a frame was read successfully; otherwise `false`.
+         * \return The result of the read. Unless a new frame was read, the buffer is left untouched.
+         */
+        VideoFrameStatus ReadVideoFrame(uint8_t* frame_buffer, const double& target_pts, double& pts);
+
+        /**
+         * \brief Reads a video frame from the file into a buffer with padded rows, such as a mapped texture.
+         * Nothing is written past the last pixel of the last row. Frames are only decoded if the current frame
+         * is behind the target timestamp, and only converted if they have not been output already.
+         * \param frame_buffer The buffer to read frame data into. It must have at least
+         * stride * (height - 1) + width * pixel_size elements.
+         * \param buffer_size The size of the buffer, in bytes, or 0 if the buffer is known to fit the output.
+         * Frames are never written to a buffer that is too small for them.
+         * \param stride The distance between the starts of consecutive rows in the buffer, in bytes, or 0 for
+         * tightly-packed rows.
+         * \param target_pts The timestamp to read frame data at. This is a "best effort" parameter.
+         * \param pts The timestamp of the actual frame that was read.
+         * \return The result of the read. Unless a new frame was read, the buffer is left untouched.
+         */
+        VideoFrameStatus ReadVideoFrame(uint8_t* frame_buffer, int buffer_size, int stride, const double& target_pts,
+                                        double& pts);
+
+        /**
+         * \brief Reads a video frame from the file and publishes it to the reader's frame ring, where it
+         * can be read in place with AcquireFrame(). Frames are only decoded if the current frame is behind the
+         * target timestamp, and only published if they have not been published already.
+         * \param target_pts The timestamp to read frame data at. This is a "best effort" parameter.
+         * \param pts The timestamp of the actual frame that was read.
+         * \return The result of the read. Unless a new frame was read, the frame ring is left untouched.
+         */
+        VideoFrameStatus PublishVideoFrame(const double& target_pts, double& pts);
+
+        /**
+         * \brief Acquires the most recently published video frame. The frame's data remains valid and unchanged
+         * until it is released with ReleaseFrame().
+         * \param info The acquired frame. This will be overwritten.
+         * \return `true` if a frame was acquired; `false` if no frame has been published yet.
          */
-        bool ReadVideoFrame(uint8_t* frame_buffer, const double& target_pts, double& pts);
+        bool AcquireFrame(VideoFrameInfo& info);
+
+        /**
+         * \brief Releases a video frame acquired with AcquireFrame().
+         * \param generation The generation of the frame to release.
+         */
+        void ReleaseFrame(int64_t generation);
 
         /**
          * \brief Seeks to the specified position in the file's audio stream. Note that not all stream
@@ -63,6 +328,73 @@ namespace Simulacrum::AV::Core
          */
         bool SeekVideoFrame(double target_pts);
 
+        /**
+         * \brief Gets the number of streams in the file, including the ones that aren't being read. Streams that
+         * some formats only announce partway through the file are counted once the reader has read that far.
+         */
+        int GetStreamCount() const;
+
+        /**
+         * \brief Describes one of the streams in the file.
+         * \param index The index of the stream to describe.
+         * \param info The description of the stream. This will be overwritten.
+         * \return `true` if the stream exists; otherwise `false`.
+         */
+        bool GetStreamInfo(int index, MediaStreamInfo& info) const;
+
+        /**
+         * \brief Switches to reading a different audio or video stream, such as another language or another
+         * rendition of the video. Playback resumes on the new stream from the current position. This can only switch
+         * between streams of a kind that was opened; it can't add audio to a video-only reader or vice versa.
+         * \param index The index of the stream to switch to.
+         * \return `true` if the switch was requested successfully; otherwise `false`.
+         */
+        bool SelectStream(int index);
+
+        /**
+         * \brief Changes the size and scaling algorithm of the video output. This takes effect on the next
+         * video frame that is read, after which the width and height reflect the new output size. Buffers passed
+         * to ReadVideoFrame() need to be resized accordingly. Frames published as-is in planar output mode are
+         * not scaled.
+         * \param output_width The width to scale video frames to, or 0 for the source width.
+         * \param output_height The height to scale video frames to, or 0 for the source height.
+         * \param scaler_flags The swscale flags to scale video frames with, or 0 for the default.
+         */
+        void SetOutputSize(int output_width, int output_height, int scaler_flags);
+
+        /**
+         * \brief Changes the maximum number of new video frames to present per second. Until the next frame is
+         * due, reading or publishing a video frame returns the previous one.
+         * \param max_frame_rate The maximum frame rate, or 0 for no limit.
+         */
+        void SetMaxFrameRate(int max_frame_rate);
+
+        /**
+         * \brief Reports how far audio playback has drifted from the master clock. Small drift is corrected
+         * gradually by stretching or squeezing the audio that is decoded next, by at most a tenth of each frame;
+         * large jumps are better handled by seeking or by dropping samples on the caller's side.
+         * \param audio_pts The timestamp of the audio that is currently playing.
+         * \param master_pts The current time of the master clock.
+         */
+        void SyncAudioClock(double audio_pts, double master_pts);
+
+        /**
+         * \brief Pauses ingestion. While paused, no new data is read from the file unless a
+         * seek is requested or the decoders run out of data.
+         */
+        void Pause();
+
+        /**
+         * \brief Resumes ingestion after a call to Pause().
+         */
+        void Play();
+
+        /**
+         * \brief Gets the usage counters of this reader's packet pool.
+         * \return The packet pool counters.
+         */
+        PacketPoolStats GetPacketPoolStats();
+
         /**
          * \brief Closes the current file and releases all resources associated with it.
          */
@@ -72,28 +404,74 @@ namespace Simulacrum::AV::Core
         struct StreamInfo
         {
             PacketQueue* packet_queue;
+            FrameQueue* frame_queue;
+            std::thread decode_thread;
+            int frame_serial;
             AVCodecContext* codec_ctx;
-            AVFrame current_frame;
+            AVFrame* current_frame;
             AVRational time_base;
-            int stream_index = -1;
+            std::atomic<int> stream_index = -1;
+            std::atomic<int> switch_stream_index = -1;
+            std::atomic<bool> reopen_requested;
             double seek_pts;
-            bool seek_requested;
+            std::atomic<bool> seek_requested;
             int seek_flags;
-            bool flush_requested;
+            std::atomic<bool> flush_requested;
+            std::atomic<bool> end_of_stream;
+            std::atomic<bool> ingest_demand;
+            bool draining = false;
+            std::atomic<double> catch_up_pts;
+            bool catching_up = false;
+            bool decimating = false;
+        };
+
+        // A stretch (positive) or squeeze (negative) applied to the audio ending at some timestamp
+        struct AudioCorrection
+        {
+            double pts;
+            double duration;
         };
 
+        VideoReaderOptions options;
+        PacketPool packet_pool;
         StreamInfo audio_stream;
         StreamInfo video_stream;
-        uint8_t* audio_buffer_pending;
-        int audio_buffer_total_size;
-        int audio_buffer_size;
-        int audio_buffer_index;
+        KeyframeIndex keyframe_index;
+        FrameRing frame_ring;
+        WorkerPool conversion_pool;
+        std::vector<std::unique_ptr<VideoScaler>> video_scalers;
+        std::mutex output_mtx;
+        int requested_output_width;
+        int requested_output_height;
+        int requested_scaler_flags;
+        std::atomic<bool> output_changed;
+        std::atomic<int> requested_max_frame_rate;
+        int video_source_format;
+        AudioBuffer resampled_audio;
+        size_t audio_buffer_target_size;
+        std::mutex audio_sync_mtx;
+        std::deque<AudioCorrection> audio_corrections;
+        double audio_clock_drift;
+        std::atomic<double> audio_read_pts;
+        int indexed_stream_index;
         int64_t video_last_frame_timestamp;
+        int64_t video_frame_generation;
+        int64_t video_output_generation;
+        double video_output_pts;
+        bool video_frame_stale;
         std::thread ingest_thread;
-        bool done;
+        std::mutex ingest_mtx;
+        std::condition_variable ingest_cv;
+        std::atomic<bool> done;
+        bool active;
+        bool paused;
+        bool ingest_stalled;
+        // Snapshot of the file's streams, since the format context can only be used on the ingest thread
+        mutable std::mutex stream_descriptions_mtx;
+        std::vector<MediaStreamInfo> stream_descriptions;
+        int described_stream_count;
 
         AVFormatContext* av_format_ctx;
-        SwsContext* sws_scaler_ctx;
         SwrContext* swr_resampler_ctx;
 
         /**
@@ -110,13 +488,98 @@ namespace Simulacrum::AV::Core
          * \param codec_ctx A pointer to the output codec context. This will be overwritten.
          * \param codec_params The codec parameters.
          * \param codec The codec itself.
+         * \param thread_count The number of threads to decode with, or 0 to let the decoder decide.
+         * \param thread_type The kind of multithreading to decode with, or 0 to let the decoder decide.
+         * \param lowres The lowres factor to decode with. This must not exceed the codec's maximum.
          * \return `true` if the operation completed successfully; otherwise `false`.
          */
         static bool InitializeCodecContext(AVCodecContext*& codec_ctx, const AVCodecParameters& codec_params,
-                                           const AVCodec& codec);
+                                           const AVCodec& codec, int thread_count, int thread_type, int lowres);
+
+        /**
+         * \brief Sets up the video decoder, applying the requested lowres factor, and the scalers for its frames.
+         * \param codec_params The codec parameters of the video stream.
+         * \param codec The video codec.
+         * \return `true` if the operation completed successfully; otherwise `false`.
+         */
+        bool InitializeVideoDecoder(const AVCodecParameters& codec_params, const AVCodec& codec);
+
+        /**
+         * \brief Picks the number of threads to use for a decoding or conversion stage.
+         * \param configured_count The thread count from the reader options, or 0 to pick one automatically.
+         * \param max_auto_count The most threads to pick automatically.
+         * \return The number of threads to use.
+         */
+        int GetThreadCount(int configured_count, int max_auto_count) const;
+
+        /**
+         * \brief Applies a pending flush request to a stream's decoder, reopening it first if the stream was
+         * switched.
+         * \param stream The stream to flush.
+         * \return `true` if the decoder was flushed; otherwise `false`.
+         */
+        bool HandleFlushRequest(StreamInfo& stream);
+
+        /**
+         * \brief Replaces the decoder of a stream with one for the file stream it currently reads from.
+         * \param stream The stream to reopen the decoder of.
+         * \return `true` if the operation completed successfully; otherwise `false`.
+         */
+        bool ReopenDecoder(StreamInfo& stream);
+
+        /**
+         * \brief Checks if a stream has been flushed since the reader last received a frame from it, or is about to
+         * be flushed for a seek that the ingest thread hasn't handled yet.
+         * \param stream The stream to check.
+         * \return `true` if the reader's current frame data is stale; otherwise `false`.
+         */
+        bool IsFlushPending(StreamInfo& stream) const;
+
+        /**
+         * \brief Decodes video frames until reaching the target timestamp. Nothing is decoded if the current
+         * frame is already at or past the target timestamp, or if the next frame isn't due yet under the
+         * maximum frame rate.
+         * \param target_pts The timestamp to read frame data at. This is a "best effort" parameter.
+         * \param pts The timestamp of the actual frame that was read.
+         * \return `true` if a frame was decoded successfully; otherwise `false`.
+         */
+        bool DecodeVideoFrameAt(const double& target_pts, double& pts);
+
+        /**
+         * \brief Checks if the current video frame still needs to be output, either because it hasn't been
+         * output yet or because the output size has changed since.
+         */
+        bool IsVideoOutputStale() const;
+
+        /**
+         * \brief Switches a stream's decoder in or out of catch-up mode, depending on how far the next packet
+         * is behind the timestamp the reader is trying to reach. In catch-up mode, non-reference frames are
+         * dropped and the loop filter is skipped. While the video frame rate is capped, non-reference frames
+         * before the next presented frame are dropped as well.
+         * \param stream The stream being decoded.
+         * \param packet The next packet to send to the decoder.
+         */
+        void UpdateCatchUpMode(StreamInfo& stream, const AVPacket& packet) const;
+
+        /**
+         * \brief Decodes the next frame of a stream on the calling thread. This feeds the decoder as many
+         * packets as it needs to produce a frame, and drains it once the end of the stream is reached.
+         * \param stream The stream to decode.
+         * \param frame The frame to decode into.
+         * \return `true` if a frame was decoded; `false` if no frame is available right now.
+         */
+        bool DecodeFrame(StreamInfo& stream, AVFrame* frame);
 
         /**
-         * \brief Decodes the next audio frame.
+         * \brief Receives the next frame of a stream into its current frame, either from its decode
+         * thread or by decoding it directly.
+         * \param stream The stream to receive a frame from.
+         * \return `true` if the operation completed successfully; otherwise `false`.
+         */
+        bool ReceiveFrame(StreamInfo& stream);
+
+        /**
+         * \brief Decodes the next audio frame and resamples it into the audio buffer.
          * \return `true` if the operation completed successfully; otherwise `false`.
          */
         bool DecodeAudioFrame();
@@ -127,23 +590,72 @@ namespace Simulacrum::AV::Core
          */
         bool DecodeVideoFrame();
 
+        /**
+         * \brief Continuously decodes frames of a stream into its frame queue, in pipelined mode.
+         * \param stream The stream to decode.
+         */
+        void DecodeLoop(StreamInfo& stream);
+
+        /**
+         * \brief Starts the decode thread of a stream, in pipelined mode.
+         * \param stream The stream to start decoding.
+         * \param queue_size The number of decoded frames to buffer.
+         */
+        void StartDecodeThread(StreamInfo& stream, int queue_size);
+
+        /**
+         * \brief Wakes the decode thread of a stream if it is blocked.
+         * \param stream The stream to wake the decoder of.
+         */
+        static void WakeDecoder(const StreamInfo& stream);
+
         int SeekAudioFrameInternal();
         int SeekVideoFrameInternal();
 
+        /**
+         * \brief Refreshes the snapshot of the file's streams, on the ingest thread. Streams that appeared since
+         * the last refresh are discarded by the demuxer unless they are being read.
+         */
+        void UpdateStreamDescriptions();
+
+        /**
+         * \brief Points a stream at a different file stream, on the ingest thread. The demuxer stops reading the old
+         * stream, and the decoder is reopened for the new one before it decodes anything else.
+         * \param stream The stream to switch.
+         * \param stream_index The index of the file stream to switch to.
+         */
+        void SwitchStreamInternal(StreamInfo& stream, int stream_index);
+
         /**
          * \brief Resamples the current audio frame data and copies it into the provided output buffer.
          * \param audio_buffer The buffer to write output samples into.
+         * \param max_samples The number of samples the output buffer has space for.
          * \param samples_read The number of samples that were read.
          * \return `true` if the operation completed successfully; otherwise `false`.
          */
-        bool CopyResampledAudio(uint8_t* audio_buffer, int& samples_read) const;
+        bool CopyResampledAudio(uint8_t* audio_buffer, int max_samples, int& samples_read) const;
 
         /**
-         * \brief Scales the current video frame data and copies it into the provided output buffer.
+         * \brief Sets up the resampler to stretch or squeeze the current audio frame towards the master clock,
+         * if it has drifted away from it.
+         * \param pts The timestamp of the first output sample of the frame.
+         */
+        void CompensateAudioDrift(double pts);
+
+        /**
+         * \brief Forgets all drift reported through SyncAudioClock(), such as after a seek.
+         */
+        void ResetAudioDrift();
+
+        /**
+         * \brief Scales the current video frame data and copies it into the provided output buffer. Large
+         * frames are split into bands of rows, which are converted in parallel on the conversion pool.
          * \param frame_buffer The frame buffer to write output data into. It must support
-         * width * height * pixel_size elements.
+         * stride * height elements.
+         * \param stride The distance between the starts of consecutive rows in the output buffer, in bytes.
+         * \return `true` if the operation completed successfully; otherwise `false`.
          */
-        void CopyScaledVideo(uint8_t* frame_buffer) const;
+        bool CopyScaledVideo(uint8_t* frame_buffer, int stride);
 
         /**
          * \brief Initializes the audio resampler context.
@@ -152,10 +664,48 @@ namespace Simulacrum::AV::Core
         bool InitializeAudioResampler();
 
         /**
-         * \brief Initializes the video scaler context.
+         * \brief Initializes the video scaler context if needed, or reconfigures it if the current frame's size or
+         * pixel format differs from the previous one's, or if a new output size was requested.
+         * \param size_changed Whether the output size changed. This will be overwritten.
          * \return `true` if the scaler context was initialized successfully; otherwise `false`.
          */
-        bool InitializeVideoScaler();
+        bool InitializeVideoScaler(bool& size_changed);
+
+        /**
+         * \brief Wakes the ingest thread if it is parked or blocked on a full packet queue.
+         */
+        void WakeIngest();
+
+        /**
+         * \brief Signals the ingest thread that a decoder has run out of packets. The ingest thread keeps
+         * reading until a packet for the stream has been queued, or until it reaches the end of the file.
+         * \param stream The stream that needs more packets.
+         */
+        void RequestIngest(StreamInfo& stream);
+
+        /**
+         * \brief Parks the ingest thread until there is something for it to do.
+         * \return `true` if ingestion should continue; `false` if the reader is shutting down.
+         */
+        bool WaitForIngest();
+
+        /**
+         * \brief Parks the ingest thread for a while before it retries a failed read.
+         * \param delay_ms The time to wait, in milliseconds. Seeks and shutdown cut this short.
+         */
+        void WaitForIngestRetry(int delay_ms);
+
+        /**
+         * \brief Pushes a packet into a stream's packet queue, waiting for space if necessary. While the other
+         * stream's decoder is waiting for packets, this doesn't wait; the queue overshoots its limits instead, and
+         * the packet is dropped if the queue is out of slots entirely. That keeps a stream whose packets aren't
+         * being consumed, or a badly interleaved file, from starving the other stream.
+         * \param stream The stream to queue the packet for.
+         * \param packet The packet to queue.
+         * \return `true` if the packet was queued; `false` if it was dropped, or made stale by a seek or shutdown
+         * request.
+         */
+        bool EnqueuePacket(const StreamInfo& stream, AVPacket* packet) const;
 
         /**
          * \brief Ingests data from the underlying streams into this instance's internal buffers.
@@ -175,9 +725,17 @@ inline DllExport void VideoReaderFree(const Simulacrum::AV::Core::VideoReader* r
     delete reader;
 }
 
-inline DllExport bool VideoReaderOpen(Simulacrum::AV::Core::VideoReader* reader, const char* uri)
+inline DllExport void VideoReaderSetKeyframeIndexDirectory(const char* directory)
+{
+    KeyframeIndex::SetCacheDirectory(directory);
+}
+
+inline DllExport bool VideoReaderOpen(
+    Simulacrum::AV::Core::VideoReader* reader,
+    const char* uri,
+    const Simulacrum::AV::Core::VideoReaderOptions* options)
 {
-    return reader->Open(uri);
+    return options ? reader->Open(uri, *options) : reader->Open(uri);
 }
 
 inline DllExport int VideoReaderReadAudioStream(
@@ -189,13 +747,43 @@ inline DllExport int VideoReaderReadAudioStream(
     return reader->ReadAudioStream(audio_buffer, len, pts);
 }
 
-inline DllExport bool VideoReaderReadVideoFrame(
+inline DllExport Simulacrum::AV::Core::VideoFrameStatus VideoReaderReadVideoFrame(
     Simulacrum::AV::Core::VideoReader* reader,
     uint8_t* frame_buffer,
+    const int buffer_size,
+    const double& target_pts,
+    double& pts)
+{
+    return reader->ReadVideoFrame(frame_buffer, buffer_size, 0, target_pts, pts);
+}
+
+inline DllExport Simulacrum::AV::Core::VideoFrameStatus VideoReaderReadVideoFrameWithStride(
+    Simulacrum::AV::Core::VideoReader* reader,
+    uint8_t* frame_buffer,
+    const int buffer_size,
+    const int stride,
+    const double& target_pts,
+    double& pts)
+{
+    return reader->ReadVideoFrame(frame_buffer, buffer_size, stride, target_pts, pts);
+}
+
+inline DllExport Simulacrum::AV::Core::VideoFrameStatus VideoReaderPublishVideoFrame(
+    Simulacrum::AV::Core::VideoReader* reader,
     const double& target_pts,
     double& pts)
 {
-    return reader->ReadVideoFrame(frame_buffer, target_pts, pts);
+    return reader->PublishVideoFrame(target_pts, pts);
+}
+
+inline DllExport bool VideoReaderAcquireFrame(Simulacrum::AV::Core::VideoReader* reader, VideoFrameInfo* info)
+{
+    return reader->AcquireFrame(*info);
+}
+
+inline DllExport void VideoReaderReleaseFrame(Simulacrum::AV::Core::VideoReader* reader, const int64_t generation)
+{
+    reader->ReleaseFrame(generation);
 }
 
 inline DllExport bool VideoReaderSeekAudioStream(Simulacrum::AV::Core::VideoReader* reader, const double target_pts)
@@ -208,11 +796,66 @@ inline DllExport bool VideoReaderSeekVideoFrame(Simulacrum::AV::Core::VideoReade
     return reader->SeekVideoFrame(target_pts);
 }
 
+inline DllExport int VideoReaderGetStreamCount(const Simulacrum::AV::Core::VideoReader* reader)
+{
+    return reader->GetStreamCount();
+}
+
+inline DllExport bool VideoReaderGetStreamInfo(
+    const Simulacrum::AV::Core::VideoReader* reader,
+    const int index,
+    Simulacrum::AV::Core::MediaStreamInfo* info)
+{
+    return reader->GetStreamInfo(index, *info);
+}
+
+inline DllExport bool VideoReaderSelectStream(Simulacrum::AV::Core::VideoReader* reader, const int index)
+{
+    return reader->SelectStream(index);
+}
+
+inline DllExport void VideoReaderSetOutputSize(
+    Simulacrum::AV::Core::VideoReader* reader,
+    const int output_width,
+    const int output_height,
+    const int scaler_flags)
+{
+    reader->SetOutputSize(output_width, output_height, scaler_flags);
+}
+
+inline DllExport void VideoReaderSetMaxFrameRate(Simulacrum::AV::Core::VideoReader* reader, const int max_frame_rate)
+{
+    reader->SetMaxFrameRate(max_frame_rate);
+}
+
+inline DllExport void VideoReaderSyncAudioClock(
+    Simulacrum::AV::Core::VideoReader* reader,
+    const double audio_pts,
+    const double master_pts)
+{
+    reader->SyncAudioClock(audio_pts, master_pts);
+}
+
+inline DllExport void VideoReaderPause(Simulacrum::AV::Core::VideoReader* reader)
+{
+    reader->Pause();
+}
+
+inline DllExport void VideoReaderPlay(Simulacrum::AV::Core::VideoReader* reader)
+{
+    reader->Play();
+}
+
 inline DllExport void VideoReaderClose(Simulacrum::AV::Core::VideoReader* reader)
 {
     reader->Close();
 }
 
+inline DllExport void VideoReaderGetPacketPoolStats(Simulacrum::AV::Core::VideoReader* reader, PacketPoolStats* stats)
+{
+    *stats = reader->GetPacketPoolStats();
+}
+
 inline DllExport int VideoReaderGetWidth(const Simulacrum::AV::Core::VideoReader* reader)
 {
     return reader->width;
@@ -223,6 +866,21 @@ inline DllExport int VideoReaderGetHeight(const Simulacrum::AV::Core::VideoReade
     return reader->height;
 }
 
+inline DllExport int VideoReaderGetLowres(const Simulacrum::AV::Core::VideoReader* reader)
+{
+    return reader->lowres;
+}
+
+inline DllExport int VideoReaderGetSourceWidth(const Simulacrum::AV::Core::VideoReader* reader)
+{
+    return reader->source_width;
+}
+
+inline DllExport int VideoReaderGetSourceHeight(const Simulacrum::AV::Core::VideoReader* reader)
+{
+    return reader->source_height;
+}
+
 inline DllExport double VideoReaderGetVideoFrameDelay(const Simulacrum::AV::Core::VideoReader* reader)
 {
     return reader->video_frame_delay;
@@ -233,6 +891,11 @@ inline DllExport int VideoReaderGetSampleRate(const Simulacrum::AV::Core::VideoR
     return reader->sample_rate;
 }
 
+inline DllExport int VideoReaderGetSampleFormat(const Simulacrum::AV::Core::VideoReader* reader)
+{
+    return reader->sample_format;
+}
+
 inline DllExport int VideoReaderGetBitsPerSample(const Simulacrum::AV::Core::VideoReader* reader)
 {
     return reader->bits_per_sample;
@@ -247,4 +910,9 @@ inline DllExport bool VideoReaderSupportsAudio(const Simulacrum::AV::Core::Video
 {
     return reader->supports_audio;
 }
+
+inline DllExport bool VideoReaderSupportsVideo(const Simulacrum::AV::Core::VideoReader* reader)
+{
+    return reader->supports_video;
+}
 }
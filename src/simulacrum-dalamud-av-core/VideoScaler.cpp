@@ -0,0 +1,228 @@
+﻿#include "VideoScaler.h"
+
+#include <cstring>
+#include "ColorConvert.h"
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+enum
+{
+    // Row alignment for the tail buffer; this keeps every row aligned for SIMD stores
+    tail_row_alignment = 64,
+    // Extra space after the tail buffer, for swscale's SIMD paths that write whole vectors at a time
+    tail_padding = 64,
+};
+
+VideoScaler::VideoScaler()
+    : ctx{},
+      dst_frame{},
+      dst_placeholder{},
+      tail_buffer{},
+      tail_capacity{},
+      tail_stride{},
+      dst_width{},
+      dst_height{},
+      color_space(-1),
+      color_range(-1)
+{
+}
+
+VideoScaler::~VideoScaler()
+{
+    Reset();
+}
+
+bool VideoScaler::Configure(const int src_width, const int src_height, const AVPixelFormat src_format,
+                            const int dst_width, const int dst_height, const int flags)
+{
+    auto* const previous_ctx = ctx;
+    ctx = sws_getCachedContext(ctx, src_width, src_height, src_format, dst_width, dst_height, AV_PIX_FMT_BGRA,
+                               flags, nullptr, nullptr, nullptr);
+    if (!ctx)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not allocate sws context");
+        return false;
+    }
+
+    if (ctx != previous_ctx)
+    {
+        // A new context starts out with swscale's own color defaults
+        color_space = -1;
+        color_range = -1;
+    }
+
+    if (!dst_frame)
+    {
+        dst_frame = av_frame_alloc();
+        // swscale only needs the output frame to be reference-counted; the data pointers we set are used as-is
+        dst_placeholder = av_buffer_alloc(1);
+        if (!dst_frame || !dst_placeholder)
+        {
+            av_log(nullptr, AV_LOG_ERROR, "[user] Could not allocate scaler output frame");
+            return false;
+        }
+    }
+
+    // The rows in the last output slice are converted into this buffer, and only their visible bytes are
+    // copied into the output
+    const auto row_size = (dst_width * 4 + tail_row_alignment - 1) & ~(tail_row_alignment - 1);
+    const auto tail_rows = static_cast<int>(sws_receive_slice_alignment(ctx));
+    if (const auto tail_size = static_cast<size_t>(row_size) * tail_rows + tail_padding; tail_size > tail_capacity)
+    {
+        av_freep(&tail_buffer);
+        tail_buffer = static_cast<uint8_t*>(av_malloc(tail_size));
+        if (!tail_buffer)
+        {
+            tail_capacity = 0;
+            av_log(nullptr, AV_LOG_ERROR, "[user] Could not allocate scaler tail buffer");
+            return false;
+        }
+
+        tail_capacity = tail_size;
+    }
+
+    tail_stride = row_size;
+    this->dst_width = dst_width;
+    this->dst_height = dst_height;
+
+    return true;
+}
+
+bool VideoScaler::IsConfigured() const
+{
+    return ctx != nullptr;
+}
+
+bool VideoScaler::Scale(const AVFrame* src, uint8_t* dst, const int stride)
+{
+    return Scale(src, dst, stride, 0, dst_height);
+}
+
+bool VideoScaler::Scale(const AVFrame* src, uint8_t* dst, const int stride, const int row_start,
+                        const int row_count)
+{
+    if (!UpdateColorDetails(src))
+    {
+        return false;
+    }
+
+    // swscale may write past the end of each row, which is harmless for every row but the last one of the
+    // band; we convert the band's last slice into a padded buffer instead and copy out only the bytes that
+    // belong to it
+    const auto row_end = row_start + row_count;
+    const auto alignment = RowAlignment();
+    const auto tail_start = row_start + (row_count - 1) / alignment * alignment;
+    if (tail_start > row_start && !ScaleRows(src, dst, stride, row_start, tail_start - row_start))
+    {
+        return false;
+    }
+
+    // Offset the tail buffer so that the first row of the slice lands at its start; swscale only touches
+    // the rows inside the slice
+    auto* tail_base = tail_buffer - static_cast<ptrdiff_t>(tail_start) * tail_stride;
+    if (!ScaleRows(src, tail_base, tail_stride, tail_start, row_end - tail_start))
+    {
+        return false;
+    }
+
+    const auto row_bytes = static_cast<size_t>(dst_width) * 4;
+    for (auto row = tail_start; row < row_end; row++)
+    {
+        memcpy(dst + static_cast<ptrdiff_t>(row) * stride, tail_buffer + (row - tail_start) * tail_stride,
+               row_bytes);
+    }
+
+    return true;
+}
+
+int VideoScaler::RowAlignment() const
+{
+    return static_cast<int>(sws_receive_slice_alignment(ctx));
+}
+
+bool VideoScaler::UpdateColorDetails(const AVFrame* src)
+{
+    // swscale would treat unspecified frames as BT.601 regardless of their size, so resolve them the same
+    // way as the SIMD converters and planar output do
+    const auto space = ResolveColorSpace(src->colorspace, src->height);
+    const auto range = ResolveColorRange(src->color_range, src->format);
+    if (space == color_space && range == color_range)
+    {
+        return true;
+    }
+
+    int* inv_table;
+    int* table;
+    int src_range, dst_range, brightness, contrast, saturation;
+    if (sws_getColorspaceDetails(ctx, &inv_table, &src_range, &table, &dst_range, &brightness, &contrast,
+                                 &saturation) < 0 ||
+        sws_setColorspaceDetails(ctx, sws_getCoefficients(space), range == AVCOL_RANGE_JPEG, table, dst_range,
+                                 brightness, contrast, saturation) < 0)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not set scaler color details");
+        return false;
+    }
+
+    color_space = space;
+    color_range = range;
+    return true;
+}
+
+bool VideoScaler::ScaleRows(const AVFrame* src, uint8_t* dst, const int stride, const int row_start,
+                            const int row_count)
+{
+    dst_frame->buf[0] = dst_placeholder;
+    dst_frame->data[0] = dst;
+    dst_frame->linesize[0] = stride;
+    dst_frame->width = dst_width;
+    dst_frame->height = dst_height;
+    dst_frame->format = AV_PIX_FMT_BGRA;
+
+    auto result = sws_frame_start(ctx, dst_frame, src);
+    if (result >= 0)
+    {
+        result = sws_send_slice(ctx, 0, src->height);
+    }
+
+    if (result >= 0)
+    {
+        result = sws_receive_slice(ctx, row_start, row_count);
+    }
+
+    sws_frame_end(ctx);
+
+    if (result < 0)
+    {
+        av_log(nullptr, AV_LOG_ERROR, "[user] Could not scale video frame");
+        return false;
+    }
+
+    return true;
+}
+
+void VideoScaler::Reset()
+{
+    if (ctx)
+    {
+        sws_freeContext(ctx);
+        ctx = nullptr;
+    }
+
+    if (dst_frame)
+    {
+        // The placeholder buffer is ours, not the frame's
+        dst_frame->buf[0] = nullptr;
+        av_frame_free(&dst_frame);
+    }
+
+    av_buffer_unref(&dst_placeholder);
+    av_freep(&tail_buffer);
+    tail_capacity = 0;
+    tail_stride = 0;
+    dst_width = 0;
+    dst_height = 0;
+    color_space = -1;
+    color_range = -1;
+}
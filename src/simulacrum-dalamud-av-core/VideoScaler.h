@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+/**
+ * \brief Converts decoded video frames into BGRA images in caller-provided memory. Output rows may be
+ * padded to any stride, and nothing is ever written past the end of the last output row, so frames can
+ * be converted straight into mapped textures and other tightly-sized buffers.
+ */
+class VideoScaler
+{
+public:
+    VideoScaler();
+    ~VideoScaler();
+
+    VideoScaler(const VideoScaler&) = delete;
+    VideoScaler& operator=(const VideoScaler&) = delete;
+
+    /**
+     * \brief Sets up the scaler for a source and output format, reusing the existing context if it matches.
+     * \param src_width The width of the source frames, in pixels.
+     * \param src_height The height of the source frames, in pixels.
+     * \param src_format The pixel format of the source frames.
+     * \param dst_width The width of the output images, in pixels.
+     * \param dst_height The height of the output images, in pixels.
+     * \param flags The swscale flags to scale with.
+     * \return `true` if the operation completed successfully; otherwise `false`.
+     */
+    bool Configure(int src_width, int src_height, AVPixelFormat src_format, int dst_width, int dst_height,
+                   int flags);
+
+    /**
+     * \brief Checks if the scaler has been configured.
+     */
+    bool IsConfigured() const;
+
+    /**
+     * \brief Converts a frame into a BGRA image.
+     * \param src The frame to convert.
+     * \param dst The output buffer. It must have at least stride * (height - 1) + width * 4 bytes.
+     * \param stride The distance between the starts of consecutive rows in the output buffer, in bytes.
+     * \return `true` if the operation completed successfully; otherwise `false`.
+     */
+    bool Scale(const AVFrame* src, uint8_t* dst, int stride);
+
+    /**
+     * \brief Converts a band of rows of a frame into a BGRA image. Nothing is written outside of the band's
+     * rows, so separate scalers can convert disjoint bands of the same image in parallel.
+     * \param src The frame to convert.
+     * \param dst The output buffer. Row 0 of the output image corresponds to the start of this buffer.
+     * \param stride The distance between the starts of consecutive rows in the output buffer, in bytes.
+     * \param row_start The first output row to convert. This must be a multiple of RowAlignment().
+     * \param row_count The number of output rows to convert. This must be a multiple of RowAlignment(),
+     * unless the band ends at the last row.
+     * \return `true` if the operation completed successfully; otherwise `false`.
+     */
+    bool Scale(const AVFrame* src, uint8_t* dst, int stride, int row_start, int row_count);
+
+    /**
+     * \brief Gets the number of rows that bands passed to Scale() must be aligned to.
+     */
+    int RowAlignment() const;
+
+    /**
+     * \brief Releases the scaler's context and buffers.
+     */
+    void Reset();
+
+private:
+    SwsContext* ctx;
+    AVFrame* dst_frame;
+    AVBufferRef* dst_placeholder;
+    uint8_t* tail_buffer;
+    size_t tail_capacity;
+    int tail_stride;
+    int dst_width;
+    int dst_height;
+    // The source color metadata the context is currently set up for, or -1 if it hasn't been set yet
+    int color_space;
+    int color_range;
+
+    bool UpdateColorDetails(const AVFrame* src);
+    bool ScaleRows(const AVFrame* src, uint8_t* dst, int stride, int row_start, int row_count);
+};
@@ -0,0 +1,104 @@
+﻿#include "WorkerPool.h"
+
+WorkerPool::WorkerPool()
+    : job{},
+      task_count{},
+      next_task{},
+      pending_tasks{},
+      done{}
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    Stop();
+}
+
+void WorkerPool::Start(const int thread_count)
+{
+    done = false;
+
+    // The submitting thread counts as one of the pool's threads
+    for (auto i = 1; i < thread_count; i++)
+    {
+        workers.emplace_back(&WorkerPool::WorkerLoop, this);
+    }
+}
+
+void WorkerPool::Stop()
+{
+    {
+        const std::unique_lock lock(mtx);
+        done = true;
+    }
+
+    work_available.notify_all();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    workers.clear();
+}
+
+int WorkerPool::ThreadCount() const
+{
+    return static_cast<int>(workers.size()) + 1;
+}
+
+void WorkerPool::Run(const int task_count, const std::function<void(int)>& task)
+{
+    if (workers.empty() || task_count <= 1)
+    {
+        for (auto i = 0; i < task_count; i++)
+        {
+            task(i);
+        }
+
+        return;
+    }
+
+    std::unique_lock lock(mtx);
+    job = &task;
+    this->task_count = task_count;
+    next_task = 0;
+    pending_tasks = task_count;
+    work_available.notify_all();
+
+    RunTasks(lock);
+    work_done.wait(lock, [this] { return pending_tasks == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::WorkerLoop()
+{
+    std::unique_lock lock(mtx);
+    while (true)
+    {
+        work_available.wait(lock, [&] { return done || next_task < task_count; });
+        if (done)
+        {
+            return;
+        }
+
+        RunTasks(lock);
+    }
+}
+
+void WorkerPool::RunTasks(std::unique_lock<std::mutex>& lock)
+{
+    while (next_task < task_count)
+    {
+        const auto index = next_task++;
+        const auto& task = *job;
+
+        lock.unlock();
+        task(index);
+        lock.lock();
+
+        if (--pending_tasks == 0)
+        {
+            work_done.notify_one();
+        }
+    }
+}
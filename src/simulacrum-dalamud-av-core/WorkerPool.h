@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief A small pool of worker threads for splitting one job into independent tasks, such as converting
+ * the bands of a video frame in parallel. The thread that submits a job works on it too.
+ */
+class WorkerPool
+{
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * \brief Starts the pool's worker threads. The pool must not already be running.
+     * \param thread_count The number of threads to run jobs on, including the thread that submits them.
+     */
+    void Start(int thread_count);
+
+    /**
+     * \brief Stops and joins the pool's worker threads.
+     */
+    void Stop();
+
+    /**
+     * \brief Gets the number of threads jobs are run on, including the thread that submits them.
+     */
+    int ThreadCount() const;
+
+    /**
+     * \brief Runs a job and blocks until all of its tasks have completed. Only one thread may submit jobs
+     * at a time.
+     * \param task_count The number of tasks in the job.
+     * \param task The function to run for each task. It is called with the index of the task.
+     */
+    void Run(int task_count, const std::function<void(int)>& task);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    const std::function<void(int)>* job;
+    int task_count;
+    int next_task;
+    int pending_tasks;
+    bool done;
+
+    void WorkerLoop();
+
+    /**
+     * \brief Runs tasks of the current job until there are none left to start.
+     * \param lock The lock on the pool's mutex, which is released while tasks run.
+     */
+    void RunTasks(std::unique_lock<std::mutex>& lock);
+};
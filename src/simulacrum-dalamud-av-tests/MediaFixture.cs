@@ -0,0 +1,305 @@
+﻿using System.Text;
+
+namespace Simulacrum.AV.Tests;
+
+/// <summary>
+/// Generates small uncompressed AVI files for the reader tests, so that they don't depend on the network.
+/// Video is raw YUV420P with a pattern that moves every frame, and each audio stream is a sine wave at a
+/// different frequency. Every video frame is a keyframe and is interleaved with one frame's worth of audio.
+/// Video can also be written as MJPEG instead, for tests that need a compressed codec; those frames are a
+/// flat gray.
+/// </summary>
+internal static class MediaFixture
+{
+    public const int FrameRate = 25;
+    public const int SampleRate = 48000;
+    public const int ChannelCount = 2;
+
+    private const int SamplesPerFrame = SampleRate / FrameRate;
+    private const int BlockAlign = ChannelCount * sizeof(short);
+
+    // Bump this whenever the generated files change, so that stale fixtures aren't reused
+    private const int Version = 1;
+
+    private static readonly object CreateLock = new();
+
+    /// <summary>
+    /// A six-second file with a 320x180 video stream and one audio stream.
+    /// </summary>
+    public static string Default => Create(320, 180, 150);
+
+    /// <summary>
+    /// Gets a fixture file with the given layout, generating it if it doesn't exist yet.
+    /// </summary>
+    /// <param name="width">The width of the video stream, or 0 for no video stream. This must be even.</param>
+    /// <param name="height">The height of the video stream. This must be even.</param>
+    /// <param name="frameCount">The duration of the file, in video frames.</param>
+    /// <param name="audioStreamCount">The number of audio streams.</param>
+    /// <param name="mjpeg">Whether to write the video stream as MJPEG rather than raw YUV420P.</param>
+    /// <returns>The path to the file.</returns>
+    public static string Create(int width, int height, int frameCount, int audioStreamCount = 1, bool mjpeg = false)
+    {
+        var directory = Path.Combine(Path.GetTempPath(), "simulacrum-av-tests");
+        var codec = mjpeg ? "-mjpeg" : "";
+        var path = Path.Combine(directory,
+            $"fixture-v{Version}-{width}x{height}-{frameCount}-{audioStreamCount}{codec}.avi");
+        lock (CreateLock)
+        {
+            if (File.Exists(path))
+            {
+                return path;
+            }
+
+            Directory.CreateDirectory(directory);
+            var tempPath = path + ".tmp";
+            using (var stream = File.Create(tempPath))
+            {
+                Write(stream, width, height, frameCount, audioStreamCount, mjpeg);
+            }
+
+            File.Move(tempPath, path, true);
+        }
+
+        return path;
+    }
+
+    /// <summary>
+    /// Gets the pts of a video frame in a fixture file.
+    /// </summary>
+    public static double FramePts(int frame)
+    {
+        return frame / (double)FrameRate;
+    }
+
+    private static void Write(Stream stream, int width, int height, int frameCount, int audioStreamCount,
+        bool mjpeg)
+    {
+        var hasVideo = width > 0;
+        var jpeg = hasVideo && mjpeg ? EncodeFlatJpeg(width, height) : null;
+        var compression = jpeg != null ? "MJPG" : "I420";
+        var frameSize = jpeg?.Length ?? width * height * 3 / 2;
+        const int audioChunkSize = SamplesPerFrame * BlockAlign;
+        var streamCount = (hasVideo ? 1 : 0) + audioStreamCount;
+
+        using var writer = new BinaryWriter(stream, Encoding.ASCII, true);
+        var riff = BeginChunk(writer, "RIFF", "AVI ");
+        var hdrl = BeginChunk(writer, "LIST", "hdrl");
+
+        WriteFourCc(writer, "avih");
+        writer.Write(56);
+        writer.Write(1_000_000 / FrameRate);
+        writer.Write((frameSize + audioChunkSize * audioStreamCount) * FrameRate);
+        writer.Write(0);
+        writer.Write(0x110); // AVIF_HASINDEX | AVIF_ISINTERLEAVED
+        writer.Write(frameCount);
+        writer.Write(0);
+        writer.Write(streamCount);
+        writer.Write(Math.Max(frameSize, audioChunkSize));
+        writer.Write(width);
+        writer.Write(height);
+        writer.Write(new byte[16]);
+
+        if (hasVideo)
+        {
+            var strl = BeginChunk(writer, "LIST", "strl");
+            WriteStreamHeader(writer, "vids", compression, 1, FrameRate, frameCount, frameSize, 0, width, height);
+
+            // BITMAPINFOHEADER
+            WriteFourCc(writer, "strf");
+            writer.Write(40);
+            writer.Write(40);
+            writer.Write(width);
+            writer.Write(height);
+            writer.Write((short)1);
+            writer.Write((short)(jpeg != null ? 24 : 12));
+            WriteFourCc(writer, compression);
+            writer.Write(frameSize);
+            writer.Write(new byte[16]);
+            EndChunk(writer, strl);
+        }
+
+        for (var i = 0; i < audioStreamCount; i++)
+        {
+            var strl = BeginChunk(writer, "LIST", "strl");
+            WriteStreamHeader(writer, "auds", "\0\0\0\0", BlockAlign, SampleRate * BlockAlign,
+                frameCount * SamplesPerFrame, audioChunkSize, BlockAlign, 0, 0);
+
+            // WAVEFORMATEX for 16-bit PCM
+            WriteFourCc(writer, "strf");
+            writer.Write(18);
+            writer.Write((short)1);
+            writer.Write((short)ChannelCount);
+            writer.Write(SampleRate);
+            writer.Write(SampleRate * BlockAlign);
+            writer.Write((short)BlockAlign);
+            writer.Write((short)16);
+            writer.Write((short)0);
+            EndChunk(writer, strl);
+        }
+
+        EndChunk(writer, hdrl);
+
+        // Index offsets are relative to the "movi" list type
+        var movi = BeginChunk(writer, "LIST", "movi");
+        var moviStart = movi + 4;
+        var index = new List<(string Id, int Offset, int Size)>();
+        var frame = new byte[frameSize];
+        var audio = new byte[audioChunkSize];
+        for (var f = 0; f < frameCount; f++)
+        {
+            if (jpeg != null)
+            {
+                index.Add(WriteDataChunk(writer, "00dc", jpeg, moviStart));
+            }
+            else if (hasVideo)
+            {
+                FillFrame(frame, width, height, f);
+                index.Add(WriteDataChunk(writer, "00dc", frame, moviStart));
+            }
+
+            for (var i = 0; i < audioStreamCount; i++)
+            {
+                FillAudio(audio, f, 440 * (i + 1));
+                index.Add(WriteDataChunk(writer, $"{i + (hasVideo ? 1 : 0):D2}wb", audio, moviStart));
+            }
+        }
+
+        EndChunk(writer, movi);
+
+        WriteFourCc(writer, "idx1");
+        writer.Write(index.Count * 16);
+        foreach (var (id, offset, size) in index)
+        {
+            WriteFourCc(writer, id);
+            writer.Write(0x10); // AVIIF_KEYFRAME
+            writer.Write(offset);
+            writer.Write(size);
+        }
+
+        EndChunk(writer, riff);
+    }
+
+    private static void FillFrame(byte[] frame, int width, int height, int f)
+    {
+        var lumaSize = width * height;
+        for (var y = 0; y < height; y++)
+        {
+            for (var x = 0; x < width; x++)
+            {
+                frame[y * width + x] = (byte)(16 + (x + y + 4 * f) % 220);
+            }
+        }
+
+        frame.AsSpan(lumaSize).Fill(128);
+    }
+
+    private static byte[] EncodeFlatJpeg(int width, int height)
+    {
+        // AVI MJPEG frames may leave out their Huffman tables, in which case decoders use the standard ones from
+        // the JPEG spec. With those tables, a 4:2:0 macroblock whose blocks are all zero is always the same four
+        // bytes: four luma blocks of DC "00" + EOB "1010", then two chroma blocks of DC "00" + EOB "00".
+        ReadOnlySpan<byte> macroblock = [0x28, 0xA2, 0x8A, 0x00];
+        var macroblockCount = (width + 15) / 16 * ((height + 15) / 16);
+
+        using var jpeg = new MemoryStream();
+        using var writer = new BinaryWriter(jpeg);
+
+        // SOI
+        writer.Write([0xFF, 0xD8]);
+
+        // DQT; the coefficients are all zero, so the quantizer doesn't matter
+        writer.Write([0xFF, 0xDB, 0x00, 0x43, 0x00]);
+        writer.Write(Enumerable.Repeat((byte)1, 64).ToArray());
+
+        // SOF0 with a 2x2-subsampled luma component and two chroma components
+        writer.Write([0xFF, 0xC0, 0x00, 0x11, 0x08]);
+        writer.Write([(byte)(height >> 8), (byte)height, (byte)(width >> 8), (byte)width]);
+        writer.Write([0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x00, 0x03, 0x11, 0x00]);
+
+        // SOS covering all three components, luma with table 0 and chroma with table 1
+        writer.Write([0xFF, 0xDA, 0x00, 0x0C, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3F, 0x00]);
+        for (var i = 0; i < macroblockCount; i++)
+        {
+            writer.Write(macroblock);
+        }
+
+        // EOI
+        writer.Write([0xFF, 0xD9]);
+        writer.Flush();
+        return jpeg.ToArray();
+    }
+
+    private static void FillAudio(byte[] audio, int f, double frequency)
+    {
+        for (var n = 0; n < SamplesPerFrame; n++)
+        {
+            var t = (f * SamplesPerFrame + n) / (double)SampleRate;
+            var sample = (short)(8000 * Math.Sin(2 * Math.PI * frequency * t));
+            for (var c = 0; c < ChannelCount; c++)
+            {
+                BitConverter.TryWriteBytes(audio.AsSpan((n * ChannelCount + c) * sizeof(short)), sample);
+            }
+        }
+    }
+
+    private static void WriteStreamHeader(BinaryWriter writer, string type, string handler, int scale, int rate,
+        int length, int suggestedBufferSize, int sampleSize, int width, int height)
+    {
+        WriteFourCc(writer, "strh");
+        writer.Write(56);
+        WriteFourCc(writer, type);
+        WriteFourCc(writer, handler);
+        writer.Write(0);
+        writer.Write((short)0);
+        writer.Write((short)0);
+        writer.Write(0);
+        writer.Write(scale);
+        writer.Write(rate);
+        writer.Write(0);
+        writer.Write(length);
+        writer.Write(suggestedBufferSize);
+        writer.Write(-1);
+        writer.Write(sampleSize);
+        writer.Write((short)0);
+        writer.Write((short)0);
+        writer.Write((short)width);
+        writer.Write((short)height);
+    }
+
+    private static (string Id, int Offset, int Size) WriteDataChunk(BinaryWriter writer, string id, byte[] data,
+        long moviStart)
+    {
+        var offset = (int)(writer.BaseStream.Position - moviStart);
+        WriteFourCc(writer, id);
+        writer.Write(data.Length);
+        writer.Write(data);
+        if (data.Length % 2 != 0)
+        {
+            writer.Write((byte)0);
+        }
+
+        return (id, offset, data.Length);
+    }
+
+    private static long BeginChunk(BinaryWriter writer, string id, string listType)
+    {
+        WriteFourCc(writer, id);
+        var sizePosition = writer.BaseStream.Position;
+        writer.Write(0);
+        WriteFourCc(writer, listType);
+        return sizePosition;
+    }
+
+    private static void EndChunk(BinaryWriter writer, long sizePosition)
+    {
+        var end = writer.BaseStream.Position;
+        writer.BaseStream.Position = sizePosition;
+        writer.Write((int)(end - sizePosition - 4));
+        writer.BaseStream.Position = end;
+    }
+
+    private static void WriteFourCc(BinaryWriter writer, string fourCc)
+    {
+        writer.Write(Encoding.ASCII.GetBytes(fourCc));
+    }
+}
\ No newline at end of file
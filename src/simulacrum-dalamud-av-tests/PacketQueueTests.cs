@@ -0,0 +1,34 @@
+﻿using System.Runtime.InteropServices;
+using Xunit.Abstractions;
+
+namespace Simulacrum.AV.Tests;
+
+public class PacketQueueTests
+{
+    private readonly ITestOutputHelper _output;
+
+    public PacketQueueTests(ITestOutputHelper output)
+    {
+        _output = output;
+    }
+
+    [Theory]
+    [Trait("Category", "Benchmark")]
+    [InlineData(false)]
+    [InlineData(true)]
+    public void PushPop_ReportsThroughput(bool legacy)
+    {
+        const int packetCount = 1_000_000;
+
+        // Warm up the threads and the allocator before measuring
+        Assert.True(PacketQueueBenchmarkRun(legacy ? 1 : 0, packetCount / 10) >= 0);
+
+        var seconds = PacketQueueBenchmarkRun(legacy ? 1 : 0, packetCount);
+        Assert.True(seconds >= 0);
+        _output.WriteLine(
+            $"{(legacy ? "Mutex queue" : "SPSC ring")}: {packetCount} packets in {seconds * 1000:F1}ms ({packetCount / seconds / 1e6:F2}M packets/s)");
+    }
+
+    [DllImport("Simulacrum.AV.Core.dll", EntryPoint = "PacketQueueBenchmarkRun")]
+    private static extern double PacketQueueBenchmarkRun(int legacy, int packetCount);
+}
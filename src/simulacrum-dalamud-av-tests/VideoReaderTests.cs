@@ -0,0 +1,956 @@
+﻿using System.Diagnostics;
+using System.Runtime.InteropServices;
+using Xunit.Abstractions;
+
+namespace Simulacrum.AV.Tests;
+
+public class VideoReaderTests
+{
+    private const string VideoUrl = "https://dc6xbzf7ukys8.cloudfront.net/chugjug.m3u8";
+
+    private static readonly string VideoPath = MediaFixture.Default;
+
+    private readonly ITestOutputHelper _output;
+
+    public VideoReaderTests(ITestOutputHelper output)
+    {
+        _output = output;
+    }
+
+    [Fact]
+    public void Ctor_Dispose_DoesNotThrow()
+    {
+        using var reader = new VideoReader();
+    }
+
+    [Fact]
+    public void Open_WithFile_ReturnsTrue()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath));
+        Assert.Equal(320, reader.Width);
+        Assert.Equal(180, reader.Height);
+        Assert.Equal(MediaFixture.SampleRate, reader.SampleRate);
+        reader.Close();
+    }
+
+    [Fact]
+    [Trait("Category", "Network")]
+    public async Task Open_WithStream_ReadsVideoFrame()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoUrl));
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+
+        reader.Close();
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public async Task ReadVideoFrame_ReadsDataIntoBuffer(bool pipelined)
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { PipelinedDecoding = pipelined }));
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+        Assert.NotEqual(0, buffer.Select(Convert.ToInt32).Sum());
+
+        // The fixture's luma ramps along both axes, so neighbouring pixels can't all be the same
+        Assert.NotEqual(buffer[..4], buffer[4..8]);
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task ReadVideoFrame_WithStride_DoesNotWritePastLastRow()
+    {
+        const byte canary = 0xCD;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath));
+
+        var rowSize = reader.Width * 4;
+        var stride = rowSize + 64;
+        var frameSize = stride * (reader.Height - 1) + rowSize;
+        var buffer = new byte[frameSize + 64];
+        buffer.AsSpan().Fill(canary);
+
+        var read = false;
+        for (var i = 0; i < 50 && !read; i++)
+        {
+            read = reader.ReadVideoFrame(buffer.AsSpan(0, frameSize), stride, 1, out _) == VideoFrameStatus.NewFrame;
+            if (!read)
+            {
+                await Task.Delay(100);
+            }
+        }
+
+        Assert.True(read);
+        Assert.All(buffer[frameSize..], b => Assert.Equal(canary, b));
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task ReadVideoFrame_WithOutputWidth_ScalesPreservingAspectRatio()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions
+        {
+            OutputWidth = 160,
+            ScalingAlgorithm = ScalingAlgorithm.Area,
+        }));
+
+        Assert.Equal(160, reader.Width);
+        Assert.Equal(reader.SourceHeight * 160 / reader.SourceWidth, reader.Height);
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+
+        // Changes take effect on the next frame that is read
+        reader.SetOutputSize(96, 54, ScalingAlgorithm.Point);
+        buffer = new byte[96 * 54 * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 2));
+        Assert.Equal(96, reader.Width);
+        Assert.Equal(54, reader.Height);
+
+        reader.Close();
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public async Task SeekVideoFrame_Backward_ReturnsFrameAtTarget(bool pipelined)
+    {
+        const double frameDuration = 1.0 / MediaFixture.FrameRate;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { PipelinedDecoding = pipelined }));
+
+        // Go back and forth a few times, so that the decode thread has frames from before each seek queued up
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        for (var i = 0; i < 3; i++)
+        {
+            Assert.True(await ReadVideoFrame(reader, buffer, 4));
+
+            Assert.True(reader.SeekVideoFrame(1));
+            var pts = await ReadVideoFramePts(reader, buffer, 1);
+            Assert.True(pts.HasValue);
+            Assert.InRange(pts.Value, 1, 1 + frameDuration - 1e-6);
+
+            // Nothing from before the seek may come out while the seek is being carried out
+            Assert.True(reader.SeekAudioStream(1));
+            var audio = new byte[4096];
+            var audioPts = 0.0;
+            for (var attempt = 0; attempt < 50 && reader.ReadAudioStream(audio, out audioPts) == 0; attempt++)
+            {
+                await Task.Delay(100);
+            }
+
+            Assert.InRange(audioPts, 1 - frameDuration, 1 + frameDuration);
+        }
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task ReadVideoFrame_AtSameFrame_DoesNotTouchBuffer()
+    {
+        const byte canary = 0xCD;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath));
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+
+        // The frame that was just read is still the one to show at the same target
+        buffer.AsSpan().Fill(canary);
+        Assert.Equal(VideoFrameStatus.NoNewFrame, reader.ReadVideoFrame(buffer, 1, out var pts));
+        Assert.True(pts >= 1);
+        Assert.All(buffer, b => Assert.Equal(canary, b));
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task ReadVideoFrame_WithMaxFrameRate_SpacesOutNewFrames()
+    {
+        const int maxFrameRate = 10;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { MaxFrameRate = maxFrameRate }));
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+
+        // Let the ingest thread buffer the next second, so that every read below has data to decode
+        await WaitForIngestToSettle(reader);
+
+        // Step through a second of playback at 60Hz, and collect the frames that were actually presented
+        var presented = new List<double>();
+        for (var t = 1.0; t < 2.0; t += 1.0 / 60)
+        {
+            var status = reader.ReadVideoFrame(buffer, t, out var pts);
+            Assert.NotEqual(VideoFrameStatus.Error, status);
+            if (status == VideoFrameStatus.NewFrame)
+            {
+                presented.Add(pts);
+            }
+        }
+
+        Assert.NotEmpty(presented);
+        Assert.All(presented.Zip(presented.Skip(1)), p => Assert.True(p.Second - p.First >= 1.0 / maxFrameRate - 1e-6));
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task Open_WithLowres_ReportsAppliedFactor()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { Lowres = 2 }));
+
+        // Raw video can't be decoded at a lower resolution, but the output size must always match what was applied
+        Assert.Equal(0, reader.Lowres);
+        Assert.Equal(reader.SourceWidth, reader.Width);
+        Assert.Equal(reader.SourceHeight, reader.Height);
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+        Assert.Equal(reader.SourceWidth, reader.Width);
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task Open_WithLowresAndMjpeg_ShrinksOutput()
+    {
+        // Neither dimension is a multiple of four, so the reduced size has to round up
+        const int width = 322;
+        const int height = 182;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(MediaFixture.Create(width, height, 25, mjpeg: true),
+            new VideoReaderOptions { Lowres = 2 }));
+
+        Assert.Equal(2, reader.Lowres);
+        Assert.Equal((width + 3) / 4, reader.Width);
+        Assert.Equal((height + 3) / 4, reader.Height);
+        Assert.Equal(reader.SourceWidth, reader.Width);
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+        Assert.Equal((width + 3) / 4, reader.Width);
+        Assert.Equal((height + 3) / 4, reader.Height);
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task ReadVideoFrame_AfterSizeChange_LeavesBufferUntouched()
+    {
+        const byte canary = 0xCD;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath));
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+
+        // Let the ingest thread buffer past the next target, so that the read below has data to decode
+        await WaitForIngestToSettle(reader);
+
+        // The next frame comes out at a different size, which the old buffer can't hold
+        reader.SetOutputSize(reader.Width * 2, reader.Height * 2);
+        buffer.AsSpan().Fill(canary);
+        Assert.Equal(VideoFrameStatus.SizeChanged, reader.ReadVideoFrame(buffer, 2, out _));
+        Assert.All(buffer, b => Assert.Equal(canary, b));
+
+        // The frame that changed size is still there to be read into a reallocated buffer
+        buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.Equal(VideoFrameStatus.NewFrame, reader.ReadVideoFrame(buffer, 2, out _));
+
+        reader.Close();
+    }
+
+    [Fact]
+    public void ReadAudioStream_Sequentially_ReportsContiguousPts()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { AudioBufferDuration = 250 }));
+
+        var bytesPerSecond = reader.SampleRate * reader.AudioChannelCount * (reader.BitsPerSample / 8);
+        var buffer = new byte[4096];
+        Assert.Equal(buffer.Length, reader.ReadAudioStream(buffer, out var pts));
+
+        // Each read should pick up exactly where the last one left off, across decoded frame boundaries
+        for (var i = 0; i < 64; i++)
+        {
+            var expectedPts = pts + buffer.Length / (double)bytesPerSecond;
+            Assert.Equal(buffer.Length, reader.ReadAudioStream(buffer, out pts));
+            Assert.Equal(expectedPts, pts, 0.001);
+        }
+
+        reader.Close();
+    }
+
+    [Fact]
+    public void ReadAudioStream_AheadOfClock_StretchesAudio()
+    {
+        const double drift = 0.05;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { AudioBufferDuration = 1 }));
+
+        var bytesPerSecond = reader.SampleRate * reader.AudioChannelCount * (reader.BitsPerSample / 8);
+        var buffer = new byte[4096];
+        Assert.Equal(buffer.Length, reader.ReadAudioStream(buffer, out var startPts));
+
+        // Audio that is ahead of the clock gets extra samples, so the same number of bytes covers less of the stream
+        reader.SyncAudioClock(startPts, startPts - drift);
+
+        var pts = startPts;
+        var bytesRead = buffer.Length;
+        while (bytesRead < bytesPerSecond * 2)
+        {
+            Assert.Equal(buffer.Length, reader.ReadAudioStream(buffer, out pts));
+            bytesRead += buffer.Length;
+        }
+
+        var expectedPts = startPts + (bytesRead - buffer.Length) / (double)bytesPerSecond;
+        Assert.InRange(expectedPts - pts, drift * 0.6, drift * 1.4);
+
+        reader.Close();
+    }
+
+    [Fact]
+    public void ReadAudioStream_WithOutputFormat_ConvertsInOnePass()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions
+        {
+            AudioSampleFormat = AudioSampleFormat.Float,
+            AudioSampleRate = 22050,
+            AudioChannelCount = 1,
+        }));
+
+        Assert.Equal(AudioSampleFormat.Float, reader.SampleFormat);
+        Assert.Equal(22050, reader.SampleRate);
+        Assert.Equal(32, reader.BitsPerSample);
+        Assert.Equal(1, reader.AudioChannelCount);
+
+        // One second of mono float samples should cover one second of the stream
+        var buffer = new byte[22050 * 4];
+        Assert.Equal(buffer.Length / 2, reader.ReadAudioStream(buffer.AsSpan(0, buffer.Length / 2), out var startPts));
+        Assert.Equal(buffer.Length, reader.ReadAudioStream(buffer, out var pts));
+        Assert.Equal(startPts + 0.5, pts, 0.001);
+
+        var samples = MemoryMarshal.Cast<byte, float>(buffer);
+        Assert.All(samples.ToArray(), sample => Assert.InRange(sample, -1.5f, 1.5f));
+
+        reader.Close();
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public async Task Open_WithAudioDisabled_ReadsVideoOnly(bool pipelined)
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions
+        {
+            PipelinedDecoding = pipelined,
+            DisableAudio = true,
+        }));
+
+        Assert.False(reader.SupportsAudio);
+        Assert.Equal(0, reader.ReadAudioStream(new byte[4096], out _));
+        Assert.False(reader.SeekAudioStream(1));
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+
+        reader.Close();
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public void Open_WithVideoDisabled_ReadsAudioOnly(bool pipelined)
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions
+        {
+            PipelinedDecoding = pipelined,
+            DisableVideo = true,
+        }));
+
+        Assert.False(reader.SupportsVideo);
+        Assert.Equal(0, reader.Width);
+        Assert.Equal(0, reader.Height);
+        Assert.Equal(VideoFrameStatus.Error, reader.ReadVideoFrame(Array.Empty<byte>(), 1, out _));
+        Assert.False(reader.SeekVideoFrame(1));
+
+        var buffer = new byte[4096];
+        Assert.Equal(buffer.Length, reader.ReadAudioStream(buffer, out _));
+
+        reader.Close();
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public async Task SeekAudioStream_WithVideoDisabled_ReturnsAudioAtTarget(bool pipelined)
+    {
+        const double frameDuration = 1.0 / MediaFixture.FrameRate;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions
+        {
+            PipelinedDecoding = pipelined,
+            DisableVideo = true,
+        }));
+
+        var buffer = new byte[4096];
+        Assert.Equal(buffer.Length, reader.ReadAudioStream(buffer, out _));
+
+        // Seek forward and then back, since the direction can't be judged from a video position here
+        foreach (var target in new[] { 4.0, 1.0 })
+        {
+            Assert.True(reader.SeekAudioStream(target));
+            var pts = 0.0;
+            for (var attempt = 0; attempt < 50 && reader.ReadAudioStream(buffer, out pts) == 0; attempt++)
+            {
+                await Task.Delay(100);
+            }
+
+            Assert.InRange(pts, target - frameDuration, target + frameDuration);
+        }
+
+        reader.Close();
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public async Task SelectStream_WithAlternateStream_KeepsReading(bool pipelined)
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(MediaFixture.Create(320, 180, 150, 2),
+            new VideoReaderOptions { PipelinedDecoding = pipelined }));
+
+        var streams = reader.GetStreams();
+        Assert.Equal(3, streams.Count);
+        Assert.Single(streams, s => s is { Type: MediaStreamType.Audio, Selected: true });
+        Assert.Single(streams, s => s is { Type: MediaStreamType.Video, Selected: true });
+        Assert.False(reader.SelectStream(streams.Count));
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+
+        var alternate = Assert.Single(streams, s => s is { Type: MediaStreamType.Audio, Selected: false });
+        Assert.True(reader.SelectStream(alternate.Index));
+        Assert.Contains(reader.GetStreams(), s => s.Index == alternate.Index && s.Selected);
+        Assert.Single(reader.GetStreams(), s => s is { Type: MediaStreamType.Audio, Selected: true });
+
+        // Both the new audio stream and the untouched video stream carry on from where playback was
+        var audio = new byte[4096];
+        Assert.Equal(audio.Length, reader.ReadAudioStream(audio, out _));
+        Assert.True(await ReadVideoFrame(reader, buffer, 2));
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task AcquireFrame_AfterPublish_ReturnsLatestFrame()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath));
+        Assert.False(reader.AcquireFrame(out _));
+
+        var published = false;
+        var pts = 0.0;
+        for (var i = 0; i < 50 && !published; i++)
+        {
+            published = reader.PublishVideoFrame(1, out pts) == VideoFrameStatus.NewFrame;
+            if (!published)
+            {
+                await Task.Delay(100);
+            }
+        }
+
+        Assert.True(published);
+        Assert.True(reader.AcquireFrame(out var frame));
+        Assert.NotEqual(nint.Zero, frame.Data[0]);
+        Assert.Equal(VideoPixelFormat.Bgra, frame.Format);
+        Assert.Equal(reader.Width, frame.Width);
+        Assert.Equal(reader.Height, frame.Height);
+        Assert.True(frame.Stride[0] >= frame.Width * 4);
+        Assert.Equal(pts, frame.Pts);
+        reader.ReleaseFrame(frame);
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task AcquireFrame_WithPlanarOutput_ReturnsDecoderPlanes()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { PlanarOutput = true }));
+
+        var published = false;
+        for (var i = 0; i < 50 && !published; i++)
+        {
+            published = reader.PublishVideoFrame(1, out _) == VideoFrameStatus.NewFrame;
+            if (!published)
+            {
+                await Task.Delay(100);
+            }
+        }
+
+        Assert.True(published);
+        Assert.True(reader.AcquireFrame(out var frame));
+        Assert.Equal(VideoPixelFormat.Yuv420P, frame.Format);
+        Assert.Equal(320, frame.Width);
+        Assert.Equal(180, frame.Height);
+        Assert.NotEqual(VideoColorRange.Unspecified, frame.ColorRange);
+        Assert.NotEqual(VideoColorSpace.Unspecified, frame.ColorSpace);
+        for (var plane = 0; plane < 3; plane++)
+        {
+            Assert.NotEqual(nint.Zero, frame.Data[plane]);
+            Assert.True(frame.Stride[plane] > 0);
+        }
+
+        reader.ReleaseFrame(frame);
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task Dispose_WithoutClose_DoesNotThrow()
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { PipelinedDecoding = true }));
+
+        // Make sure the background threads are busy when the reader goes away
+        for (var i = 0; i < 50 && reader.GetPacketPoolStats().Acquired < 2; i++)
+        {
+            await Task.Delay(10);
+        }
+
+        Assert.True(reader.GetPacketPoolStats().Acquired >= 2);
+    }
+
+    [Fact]
+    public async Task SeekVideoFrame_WithCachedKeyframeIndex_LandsOnTarget()
+    {
+        // Matches the layout KeyframeIndex writes: a 40-byte header, then 24 bytes per keyframe
+        const int headerSize = 40;
+        const int entrySize = 24;
+        const int frameCount = 150;
+
+        // Use a file of our own, so that other tests don't build or use its index
+        var path = MediaFixture.Create(160, 90, frameCount, 0);
+        var directory = Path.Combine(Path.GetTempPath(), "simulacrum-av-tests", $"kfi-{Guid.NewGuid():N}");
+        VideoReader.SetKeyframeIndexDirectory(directory);
+        try
+        {
+            using var reader = new VideoReader();
+            var buffer = new byte[160 * 90 * 4];
+
+            // Demuxing the whole file indexes every frame, since each one is a keyframe
+            Assert.True(reader.Open(path));
+            Assert.Equal(frameCount, (await ReadAllFrames(reader, buffer)).Count);
+            reader.Close();
+
+            var indexPath = Assert.Single(Directory.GetFiles(directory, "*.kfi"));
+            Assert.Equal(headerSize + frameCount * entrySize, new FileInfo(indexPath).Length);
+
+            // Seeking with the cached index still lands exactly on the target
+            Assert.True(reader.Open(path));
+            Assert.True(reader.SeekVideoFrame(3));
+            Assert.True(await ReadVideoFrame(reader, buffer, 3));
+            Assert.Equal(VideoFrameStatus.NoNewFrame, reader.ReadVideoFrame(buffer, 3, out var pts));
+            Assert.Equal(3, pts, 1e-3);
+            reader.Close();
+
+            // A truncated index is ignored rather than trusted, and gets rebuilt
+            using (var file = File.Open(indexPath, FileMode.Open))
+            {
+                file.SetLength(headerSize + entrySize / 2);
+            }
+
+            Assert.True(reader.Open(path));
+            Assert.True(reader.SeekVideoFrame(2));
+            Assert.True(await ReadVideoFrame(reader, buffer, 2));
+            Assert.Equal(VideoFrameStatus.NoNewFrame, reader.ReadVideoFrame(buffer, 2, out pts));
+            Assert.Equal(2, pts, 1e-3);
+            reader.Close();
+
+            Assert.True(new FileInfo(indexPath).Length > headerSize + entrySize);
+        }
+        finally
+        {
+            VideoReader.SetKeyframeIndexDirectory(null);
+            Directory.Delete(directory, true);
+        }
+    }
+
+    [Fact]
+    public async Task Open_WithLongFile_BoundsBufferedPackets()
+    {
+        // Twenty seconds of video is far more than the packet queue may hold
+        const int frameCount = 20 * MediaFixture.FrameRate;
+        const int maxQueuedFrames = 5 * MediaFixture.FrameRate;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(MediaFixture.Create(320, 180, frameCount),
+            new VideoReaderOptions { DisableAudio = true }));
+
+        // Nothing is being decoded, so the ingest thread only stops once the queue is full
+        await WaitForIngestToSettle(reader);
+
+        // The ingest thread also holds on to the packet that didn't fit
+        var stats = reader.GetPacketPoolStats();
+        Assert.Equal(0L, stats.Released);
+        Assert.InRange(stats.Acquired, 2, maxQueuedFrames + 1);
+
+        // Reading frames makes room for more packets
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.True(await ReadVideoFrame(reader, buffer, 1));
+        await WaitForIngestToSettle(reader);
+        Assert.True(reader.GetPacketPoolStats().Acquired > stats.Acquired);
+
+        reader.Close();
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public async Task ReadVideoFrame_ThroughWholeFile_ReturnsEveryFrame(bool pipelined)
+    {
+        const int frameCount = 150;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { PipelinedDecoding = pipelined }));
+
+        // The last frames only come out once the decoder has been drained at the end of the file
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        var presented = await ReadAllFrames(reader, buffer);
+        AssertConsecutiveFrames(presented, frameCount);
+        Assert.Equal(MediaFixture.FramePts(0), presented[0], 1e-3);
+        Assert.Equal(MediaFixture.FramePts(frameCount - 1), presented[^1], 1e-3);
+
+        reader.Close();
+    }
+
+    [Fact]
+    public async Task ReadVideoFrame_WithoutReadingAudio_KeepsReadingVideo()
+    {
+        // Long enough that the unread audio fills its queue several times over
+        const int frameCount = 20 * MediaFixture.FrameRate;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(MediaFixture.Create(160, 90, frameCount)));
+        Assert.True(reader.SupportsAudio);
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        var presented = await ReadAllFrames(reader, buffer);
+        AssertConsecutiveFrames(presented, frameCount);
+
+        reader.Close();
+    }
+
+    [Theory]
+    [InlineData(false)]
+    [InlineData(true)]
+    public async Task ReadVideoFrame_ThroughWholeFile_ReusesPooledPackets(bool pipelined)
+    {
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions
+        {
+            PipelinedDecoding = pipelined,
+            DisableAudio = true,
+        }));
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        Assert.NotEmpty(await ReadAllFrames(reader, buffer));
+
+        // Every packet went back to the pool except the one the ingest thread is holding for its next read,
+        // and packets were only allocated while the queue first filled up
+        var stats = reader.GetPacketPoolStats();
+        Assert.InRange(stats.Acquired - stats.Released, 0, 1);
+        Assert.InRange(stats.Allocated, 1, 5 * MediaFixture.FrameRate + 2);
+        Assert.True(stats.Allocated < stats.Acquired);
+        Assert.True(stats.HitRate > 0);
+
+        reader.Close();
+    }
+
+    [Theory]
+    [Trait("Category", "Benchmark")]
+    [InlineData(1, DecoderThreadType.Frame)]
+    [InlineData(2, DecoderThreadType.Frame)]
+    [InlineData(4, DecoderThreadType.Frame)]
+    [InlineData(8, DecoderThreadType.Frame)]
+    [InlineData(4, DecoderThreadType.Slice)]
+    [InlineData(0, DecoderThreadType.Auto)]
+    public async Task ReadVideoFrame_WithDecoderThreads_ReportsDecodedFps(int threadCount, DecoderThreadType threadType)
+    {
+        const int frameCount = 120;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions
+        {
+            DecoderThreadCount = threadCount,
+            DecoderThreadType = threadType,
+        }));
+
+        // Let the ingest thread buffer some packets so we measure decoding rather than reading the file
+        await WaitForIngestToSettle(reader);
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        var stopwatch = Stopwatch.StartNew();
+        var decoded = ReadConsecutiveFrames(reader, buffer, frameCount);
+        stopwatch.Stop();
+        reader.Close();
+
+        AssertConsecutiveFrames(decoded, frameCount);
+        _output.WriteLine(
+            $"{threadType} x{threadCount}: {decoded.Count} frames in {stopwatch.Elapsed.TotalMilliseconds:F1}ms ({decoded.Count / stopwatch.Elapsed.TotalSeconds:F1} fps)");
+    }
+
+    [Theory]
+    [Trait("Category", "Benchmark")]
+    [InlineData(false)]
+    [InlineData(true)]
+    public async Task ReadVideoFrame_WithDistantTarget_ReportsCatchUpLatency(bool disableCatchUp)
+    {
+        const double targetPts = 4;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions { DisableCatchUpDecoding = disableCatchUp }));
+
+        // Let the ingest thread buffer past the target so we measure decoding rather than reading the file
+        await WaitForIngestToSettle(reader);
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        var stopwatch = Stopwatch.StartNew();
+        var status = reader.ReadVideoFrame(buffer, targetPts, out var pts);
+        stopwatch.Stop();
+        reader.Close();
+
+        // Catching up may skip frames, but must still land on the first one at or after the target
+        Assert.Equal(VideoFrameStatus.NewFrame, status);
+        Assert.Equal(targetPts, pts, 1e-3);
+        _output.WriteLine(
+            $"Catch-up {(disableCatchUp ? "disabled" : "enabled")}: reached {pts:F3}s in {stopwatch.Elapsed.TotalMilliseconds:F1}ms");
+    }
+
+    [Theory]
+    [Trait("Category", "Benchmark")]
+    [InlineData(320, 180, 120, false)]
+    [InlineData(320, 180, 120, true)]
+    [InlineData(1280, 720, 60, false)]
+    [InlineData(1280, 720, 60, true)]
+    [InlineData(1920, 1080, 30, false)]
+    [InlineData(1920, 1080, 30, true)]
+    [InlineData(3840, 2160, 10, false)]
+    [InlineData(3840, 2160, 10, true)]
+    public async Task ReadVideoFrame_WithSimdConversion_ReportsConversionTime(int width, int height, int frameCount,
+        bool disableSimd)
+    {
+        // Reading starts just after the first frame, so the file needs one more frame than we read
+        var path = MediaFixture.Create(width, height, frameCount + 1);
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(path, new VideoReaderOptions { DisableSimdConversion = disableSimd }));
+
+        // Let the ingest thread buffer some packets so we measure decoding rather than reading the file; at the
+        // larger sizes the packet queue only holds a few frames, so some of the read time is still counted
+        await WaitForIngestToSettle(reader);
+
+        // Every frame is decoded in both runs, so the difference between them is the conversion cost
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        var stopwatch = Stopwatch.StartNew();
+        var read = ReadConsecutiveFrames(reader, buffer, frameCount);
+        stopwatch.Stop();
+        reader.Close();
+
+        AssertConsecutiveFrames(read, frameCount);
+        _output.WriteLine(
+            $"{(disableSimd ? "swscale" : "SIMD")} at {reader.Width}x{reader.Height}: {stopwatch.Elapsed.TotalMilliseconds / read.Count:F3}ms per frame");
+    }
+
+    [Theory]
+    [Trait("Category", "Benchmark")]
+    [InlineData(1)]
+    [InlineData(2)]
+    [InlineData(4)]
+    [InlineData(8)]
+    public async Task ReadVideoFrame_WithConversionThreads_ReportsConversionTime(int threadCount)
+    {
+        const int frameCount = 60;
+
+        // Upscale to 4K so that conversion, rather than decoding, dominates each read
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(VideoPath, new VideoReaderOptions
+        {
+            OutputWidth = 3840,
+            OutputHeight = 2160,
+            ConversionThreadCount = threadCount,
+        }));
+
+        // Let the ingest thread buffer some packets so we measure decoding rather than reading the file
+        await WaitForIngestToSettle(reader);
+
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        var stopwatch = Stopwatch.StartNew();
+        var read = ReadConsecutiveFrames(reader, buffer, frameCount);
+        stopwatch.Stop();
+        reader.Close();
+
+        AssertConsecutiveFrames(read, frameCount);
+        _output.WriteLine(
+            $"x{threadCount} at {reader.Width}x{reader.Height}: {stopwatch.Elapsed.TotalMilliseconds / read.Count:F3}ms per frame");
+    }
+
+    [Theory]
+    [Trait("Category", "Benchmark")]
+    [InlineData(false)]
+    [InlineData(true)]
+    public void ReadVideoFrame_WithTinyFrames_ReportsPacketThroughput(bool pipelined)
+    {
+        // A minute of tiny frames, so that moving packets from the ingest thread to the decoder dominates
+        const int frameCount = 60 * MediaFixture.FrameRate;
+        const double idleTimeout = 1;
+
+        using var reader = new VideoReader();
+        Assert.True(reader.Open(MediaFixture.Create(64, 36, frameCount), new VideoReaderOptions
+        {
+            PipelinedDecoding = pipelined,
+            DisableAudio = true,
+        }));
+
+        // Don't wait for the queue to fill up, so that the ingest thread has to keep up with us
+        var buffer = new byte[reader.Width * reader.Height * 4];
+        var read = 0;
+        var pts = double.NegativeInfinity;
+        var stopwatch = Stopwatch.StartNew();
+        var lastFrameTime = TimeSpan.Zero;
+        while ((stopwatch.Elapsed - lastFrameTime).TotalSeconds < idleTimeout)
+        {
+            if (reader.ReadVideoFrame(buffer, Math.BitIncrement(pts), out var framePts) == VideoFrameStatus.NewFrame)
+            {
+                read++;
+                pts = framePts;
+                lastFrameTime = stopwatch.Elapsed;
+            }
+            else
+            {
+                Thread.Yield();
+            }
+        }
+
+        var stats = reader.GetPacketPoolStats();
+        reader.Close();
+
+        Assert.Equal(frameCount, read);
+        Assert.Equal(MediaFixture.FramePts(frameCount - 1), pts, 1e-3);
+        _output.WriteLine(
+            $"{(pipelined ? "Pipelined" : "Synchronous")}: {read} packets in {lastFrameTime.TotalMilliseconds:F1}ms ({read / lastFrameTime.TotalSeconds:F0} packets/s, {stats.HitRate:P1} pool hits)");
+    }
+
+    private static List<double> ReadConsecutiveFrames(VideoReader reader, byte[] buffer, int frameCount)
+    {
+        var presented = new List<double>();
+        var pts = 0.0;
+        while (presented.Count < frameCount)
+        {
+            // Aim just past the previous frame, so that every read decodes the next one
+            if (reader.ReadVideoFrame(buffer, Math.BitIncrement(pts), out pts) != VideoFrameStatus.NewFrame)
+            {
+                break;
+            }
+
+            presented.Add(pts);
+        }
+
+        return presented;
+    }
+
+    private static void AssertConsecutiveFrames(List<double> presented, int frameCount)
+    {
+        Assert.Equal(frameCount, presented.Count);
+        Assert.All(presented.Zip(presented.Skip(1)),
+            p => Assert.Equal(1.0 / MediaFixture.FrameRate, p.Second - p.First, 1e-3));
+    }
+
+    private static async Task<List<double>> ReadAllFrames(VideoReader reader, byte[] buffer)
+    {
+        // Data is ingested asynchronously, so give each frame some time to arrive before deciding that
+        // we've reached the end of the file
+        var presented = new List<double>();
+        var pts = double.NegativeInfinity;
+        for (var attempt = 0; attempt < 20;)
+        {
+            if (reader.ReadVideoFrame(buffer, Math.BitIncrement(pts), out var framePts) == VideoFrameStatus.NewFrame)
+            {
+                presented.Add(framePts);
+                pts = framePts;
+                attempt = 0;
+            }
+            else
+            {
+                attempt++;
+                await Task.Delay(50);
+            }
+        }
+
+        return presented;
+    }
+
+    private static async Task WaitForIngestToSettle(VideoReader reader)
+    {
+        // The ingest thread reads ahead until the packet queues are full or it reaches the end of the file,
+        // at which point it stops taking packets from the pool
+        const int settledPolls = 5;
+
+        var lastAcquired = -1L;
+        var unchanged = 0;
+        for (var i = 0; i < 500 && unchanged < settledPolls; i++)
+        {
+            var acquired = reader.GetPacketPoolStats().Acquired;
+            unchanged = acquired == lastAcquired ? unchanged + 1 : 0;
+            lastAcquired = acquired;
+            await Task.Delay(20);
+        }
+
+        Assert.Equal(settledPolls, unchanged);
+    }
+
+    private static async Task<double?> ReadVideoFramePts(VideoReader reader, byte[] buffer, double targetPts)
+    {
+        // Data is ingested asynchronously, so there may not be a frame available immediately
+        for (var i = 0; i < 50; i++)
+        {
+            if (reader.ReadVideoFrame(buffer, targetPts, out var pts) == VideoFrameStatus.NewFrame)
+            {
+                return pts;
+            }
+
+            await Task.Delay(100);
+        }
+
+        return null;
+    }
+
+    private static async Task<bool> ReadVideoFrame(VideoReader reader, byte[] buffer, double targetPts)
+    {
+        return await ReadVideoFramePts(reader, buffer, targetPts) != null;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+﻿namespace Simulacrum.AV;
+
+/// <summary>
+/// The sample formats a <see cref="VideoReader"/> can output audio in. The values match libavutil's sample formats.
+/// </summary>
+public enum AudioSampleFormat
+{
+    Default = 0,
+    S16 = 1,
+    Float = 3,
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+﻿namespace Simulacrum.AV;
+
+/// <summary>
+/// The kind of threading the video decoder uses. The values match libavcodec's FF_THREAD_* flags, and Auto
+/// leaves libavcodec's default in place.
+/// </summary>
+public enum DecoderThreadType
+{
+    Auto = 0,
+    Frame = 1,
+    Slice = 2,
+}
\ No newline at end of file
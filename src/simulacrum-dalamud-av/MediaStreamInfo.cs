@@ -0,0 +1,58 @@
+﻿using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Text;
+
+namespace Simulacrum.AV;
+
+/// <summary>
+/// Describes one of the streams in a file opened by a <see cref="VideoReader"/>. The <see cref="Index"/> can be
+/// passed to <see cref="VideoReader.SelectStream"/> to switch to the stream.
+/// </summary>
+[StructLayout(LayoutKind.Sequential)]
+public struct MediaStreamInfo
+{
+    public int Index;
+    public MediaStreamType Type;
+    public int CodecId;
+    public CodecNameBuffer CodecNameBytes;
+    public LanguageBuffer LanguageBytes;
+    public long BitRate;
+    public int Width;
+    public int Height;
+    public int SampleRate;
+    public int ChannelCount;
+    private int _selected;
+
+    /// <summary>
+    /// Whether the stream is currently being read.
+    /// </summary>
+    public readonly bool Selected => _selected != 0;
+
+    /// <summary>
+    /// The short name of the stream's codec.
+    /// </summary>
+    public readonly string CodecName => DecodeString(CodecNameBytes);
+
+    /// <summary>
+    /// The language the stream is tagged with, or an empty string if it isn't tagged.
+    /// </summary>
+    public readonly string Language => DecodeString(LanguageBytes);
+
+    private static string DecodeString(ReadOnlySpan<byte> bytes)
+    {
+        var length = bytes.IndexOf((byte)0);
+        return Encoding.UTF8.GetString(length < 0 ? bytes : bytes[..length]);
+    }
+
+    [InlineArray(32)]
+    public struct CodecNameBuffer
+    {
+        private byte _element0;
+    }
+
+    [InlineArray(16)]
+    public struct LanguageBuffer
+    {
+        private byte _element0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+﻿namespace Simulacrum.AV;
+
+/// <summary>
+/// The kind of data a stream in a media file holds. The values match libavutil's media types.
+/// </summary>
+public enum MediaStreamType
+{
+    Unknown = -1,
+    Video = 0,
+    Audio = 1,
+    Data = 2,
+    Subtitle = 3,
+    Attachment = 4,
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+﻿using System.Runtime.InteropServices;
+
+namespace Simulacrum.AV;
+
+[StructLayout(LayoutKind.Sequential)]
+public struct PacketPoolStats
+{
+    public long Acquired;
+    public long Allocated;
+    public long Released;
+    public long Pooled;
+
+    /// <summary>
+    /// The fraction of packet acquisitions that were served without allocating a new packet.
+    /// </summary>
+    public readonly double HitRate => Acquired > 0 ? (double)(Acquired - Allocated) / Acquired : 0;
+}
\ No newline at end of file
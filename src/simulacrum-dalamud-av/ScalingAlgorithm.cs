@@ -0,0 +1,15 @@
+﻿namespace Simulacrum.AV;
+
+/// <summary>
+/// The algorithm used to scale video frames to the output size. The values match libswscale's flags.
+/// </summary>
+public enum ScalingAlgorithm
+{
+    Default = 0,
+    FastBilinear = 0x1,
+    Bilinear = 0x2,
+    Bicubic = 0x4,
+    Point = 0x10,
+    Area = 0x20,
+    Lanczos = 0x200,
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+﻿namespace Simulacrum.AV;
+
+/// <summary>
+/// The YUV value range of a <see cref="VideoFrame"/>. The values match libavutil's color ranges.
+/// </summary>
+public enum VideoColorRange
+{
+    Unspecified = 0,
+    Limited = 1,
+    Full = 2,
+}
\ No newline at end of file
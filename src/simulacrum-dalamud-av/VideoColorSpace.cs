@@ -0,0 +1,16 @@
+﻿namespace Simulacrum.AV;
+
+/// <summary>
+/// The YUV color matrix of a <see cref="VideoFrame"/>. The values match libavutil's color spaces.
+/// </summary>
+public enum VideoColorSpace
+{
+    Rgb = 0,
+    Bt709 = 1,
+    Unspecified = 2,
+    Fcc = 4,
+    Bt470Bg = 5,
+    Smpte170M = 6,
+    Smpte240M = 7,
+    Bt2020Ncl = 9,
+}
\ No newline at end of file
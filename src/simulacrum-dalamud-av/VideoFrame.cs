@@ -0,0 +1,35 @@
+﻿using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+
+namespace Simulacrum.AV;
+
+/// <summary>
+/// A video frame owned by a <see cref="VideoReader"/>. The frame data remains valid until the frame is
+/// passed to <see cref="VideoReader.ReleaseFrame"/>. BGRA frames only use the first plane; planar frames
+/// use one plane per component, or two for NV12.
+/// </summary>
+[StructLayout(LayoutKind.Sequential)]
+public struct VideoFrame
+{
+    public PlanePointers Data;
+    public PlaneStrides Stride;
+    public int Width;
+    public int Height;
+    public VideoPixelFormat Format;
+    public VideoColorSpace ColorSpace;
+    public VideoColorRange ColorRange;
+    public double Pts;
+    public long Generation;
+
+    [InlineArray(4)]
+    public struct PlanePointers
+    {
+        private nint _element0;
+    }
+
+    [InlineArray(4)]
+    public struct PlaneStrides
+    {
+        private int _element0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+﻿namespace Simulacrum.AV;
+
+/// <summary>
+/// The result of reading or publishing a video frame with a <see cref="VideoReader"/>.
+/// </summary>
+public enum VideoFrameStatus
+{
+    /// <summary>
+    /// No frame could be read.
+    /// </summary>
+    Error = 0,
+
+    /// <summary>
+    /// A frame that had not been output before was read and written to the output.
+    /// </summary>
+    NewFrame = 1,
+
+    /// <summary>
+    /// The frame at the target timestamp is the one that was already output last time, so nothing was
+    /// written to the output.
+    /// </summary>
+    NoNewFrame = 2,
+
+    /// <summary>
+    /// A new frame was read, but the output size has changed since the previous one. Reading into a buffer
+    /// leaves it untouched, so that it can be reallocated for the new <see cref="VideoReader.Width"/> and
+    /// <see cref="VideoReader.Height"/> and read again; publishing publishes the frame at its new size.
+    /// </summary>
+    SizeChanged = 3,
+}
\ No newline at end of file
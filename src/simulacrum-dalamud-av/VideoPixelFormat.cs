@@ -0,0 +1,11 @@
+﻿namespace Simulacrum.AV;
+
+/// <summary>
+/// The pixel formats a <see cref="VideoFrame"/> can be in. The values match libavutil's pixel formats.
+/// </summary>
+public enum VideoPixelFormat
+{
+    Yuv420P = 0,
+    Nv12 = 23,
+    Bgra = 28,
+}
\ No newline at end of file
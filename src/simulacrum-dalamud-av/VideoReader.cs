@@ -8,12 +8,19 @@ public partial class VideoReader : IDisposable
 
     public int Width => _ptr != nint.Zero ? VideoReaderGetWidth(_ptr) : 0;
     public int Height => _ptr != nint.Zero ? VideoReaderGetHeight(_ptr) : 0;
+    public int SourceWidth => _ptr != nint.Zero ? VideoReaderGetSourceWidth(_ptr) : 0;
+    public int SourceHeight => _ptr != nint.Zero ? VideoReaderGetSourceHeight(_ptr) : 0;
+    public int Lowres => _ptr != nint.Zero ? VideoReaderGetLowres(_ptr) : 0;
 
     public TimeSpan VideoFrameDelay =>
         _ptr != nint.Zero ? TimeSpan.FromSeconds(VideoReaderGetVideoFrameDelay(_ptr)) : TimeSpan.Zero;
 
     public bool SupportsAudio => _ptr != nint.Zero && VideoReaderSupportsAudio(_ptr);
+    public bool SupportsVideo => _ptr != nint.Zero && VideoReaderSupportsVideo(_ptr);
     public int SampleRate => _ptr != nint.Zero ? VideoReaderGetSampleRate(_ptr) : 0;
+    public AudioSampleFormat SampleFormat =>
+        _ptr != nint.Zero ? (AudioSampleFormat)VideoReaderGetSampleFormat(_ptr) : AudioSampleFormat.Default;
+
     public int BitsPerSample => _ptr != nint.Zero ? VideoReaderGetBitsPerSample(_ptr) : 0;
     public int AudioChannelCount => _ptr != nint.Zero ? VideoReaderGetAudioChannelCount(_ptr) : 0;
 
@@ -22,10 +29,20 @@ public partial class VideoReader : IDisposable
         _ptr = VideoReaderAlloc();
     }
 
+    public static void SetKeyframeIndexDirectory(string? directory)
+    {
+        VideoReaderSetKeyframeIndexDirectory(directory);
+    }
+
     public bool Open(string? filename)
+    {
+        return Open(filename, default);
+    }
+
+    public bool Open(string? filename, VideoReaderOptions options)
     {
         ArgumentNullException.ThrowIfNull(filename);
-        return _ptr != nint.Zero && VideoReaderOpen(_ptr, filename);
+        return _ptr != nint.Zero && VideoReaderOpen(_ptr, filename, in options);
     }
 
     public int ReadAudioStream(Span<byte> audioBuffer, out double pts)
@@ -39,10 +56,53 @@ public partial class VideoReader : IDisposable
         return _ptr != nint.Zero && VideoReaderSeekAudioStream(_ptr, targetPts);
     }
 
-    public bool ReadVideoFrame(Span<byte> frameBuffer, double targetPts, out double pts)
+    public VideoFrameStatus ReadVideoFrame(Span<byte> frameBuffer, double targetPts, out double pts)
     {
         pts = 0;
-        return _ptr != nint.Zero && VideoReaderReadVideoFrame(_ptr, frameBuffer, targetPts, out pts);
+        return _ptr != nint.Zero
+            ? VideoReaderReadVideoFrame(_ptr, frameBuffer, frameBuffer.Length, targetPts, out pts)
+            : VideoFrameStatus.Error;
+    }
+
+    public VideoFrameStatus ReadVideoFrame(Span<byte> frameBuffer, int stride, double targetPts, out double pts)
+    {
+        pts = 0;
+        if (_ptr == nint.Zero)
+        {
+            return VideoFrameStatus.Error;
+        }
+
+        // The reader writes exactly this much, and never pads the last row out to the stride
+        var width = Width;
+        var height = Height;
+        if (stride < width * 4 || frameBuffer.Length < stride * (height - 1) + width * 4)
+        {
+            throw new ArgumentException("The frame buffer is too small for the requested stride.", nameof(frameBuffer));
+        }
+
+        return VideoReaderReadVideoFrameWithStride(_ptr, frameBuffer, frameBuffer.Length, stride, targetPts, out pts);
+    }
+
+    public VideoFrameStatus PublishVideoFrame(double targetPts, out double pts)
+    {
+        pts = 0;
+        return _ptr != nint.Zero ? VideoReaderPublishVideoFrame(_ptr, targetPts, out pts) : VideoFrameStatus.Error;
+    }
+
+    public bool AcquireFrame(out VideoFrame frame)
+    {
+        frame = default;
+        return _ptr != nint.Zero && VideoReaderAcquireFrame(_ptr, out frame);
+    }
+
+    public void ReleaseFrame(in VideoFrame frame)
+    {
+        if (_ptr == nint.Zero)
+        {
+            return;
+        }
+
+        VideoReaderReleaseFrame(_ptr, frame.Generation);
     }
 
     public bool SeekVideoFrame(double targetPts)
@@ -50,6 +110,92 @@ public partial class VideoReader : IDisposable
         return _ptr != nint.Zero && VideoReaderSeekVideoFrame(_ptr, targetPts);
     }
 
+    public IReadOnlyList<MediaStreamInfo> GetStreams()
+    {
+        if (_ptr == nint.Zero)
+        {
+            return [];
+        }
+
+        var count = VideoReaderGetStreamCount(_ptr);
+        var streams = new List<MediaStreamInfo>(count);
+        for (var i = 0; i < count; i++)
+        {
+            if (VideoReaderGetStreamInfo(_ptr, i, out var info))
+            {
+                streams.Add(info);
+            }
+        }
+
+        return streams;
+    }
+
+    public bool SelectStream(int index)
+    {
+        return _ptr != nint.Zero && VideoReaderSelectStream(_ptr, index);
+    }
+
+    public PacketPoolStats GetPacketPoolStats()
+    {
+        var stats = new PacketPoolStats();
+        if (_ptr != nint.Zero)
+        {
+            VideoReaderGetPacketPoolStats(_ptr, ref stats);
+        }
+
+        return stats;
+    }
+
+    public void SetOutputSize(int width, int height, ScalingAlgorithm algorithm = ScalingAlgorithm.Default)
+    {
+        if (_ptr == nint.Zero)
+        {
+            return;
+        }
+
+        VideoReaderSetOutputSize(_ptr, width, height, (int)algorithm);
+    }
+
+    public void SetMaxFrameRate(int maxFrameRate)
+    {
+        if (_ptr == nint.Zero)
+        {
+            return;
+        }
+
+        VideoReaderSetMaxFrameRate(_ptr, maxFrameRate);
+    }
+
+    public void SyncAudioClock(double audioPts, double masterPts)
+    {
+        if (_ptr == nint.Zero)
+        {
+            return;
+        }
+
+        VideoReaderSyncAudioClock(_ptr, audioPts, masterPts);
+    }
+
+    public void Pause()
+    {
+        if (_ptr == nint.Zero)
+        {
+            return;
+        }
+
+        VideoReaderPause(_ptr);
+    }
+
+    public void Play()
+    {
+        if (_ptr == nint.Zero)
+        {
+            return;
+        }
+
+        VideoReaderPlay(_ptr);
+    }
+
     public void Close()
     {
         if (_ptr == nint.Zero)
@@ -88,9 +234,14 @@ public partial class VideoReader : IDisposable
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderFree")]
     internal static partial void VideoReaderFree(nint reader);
 
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderSetKeyframeIndexDirectory")]
+    internal static partial void VideoReaderSetKeyframeIndexDirectory(
+        [MarshalAs(UnmanagedType.LPStr)] string? directory);
+
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderOpen")]
     [return: MarshalAs(UnmanagedType.Bool)]
-    internal static partial bool VideoReaderOpen(nint reader, [MarshalAs(UnmanagedType.LPStr)] string uri);
+    internal static partial bool VideoReaderOpen(nint reader, [MarshalAs(UnmanagedType.LPStr)] string uri,
+        in VideoReaderOptions options);
 
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderReadAudioStream")]
     internal static partial int VideoReaderReadAudioStream(nint reader, Span<byte> audioBuffer, int len,
@@ -101,29 +252,84 @@ public partial class VideoReader : IDisposable
     internal static partial bool VideoReaderSeekAudioStream(nint reader, double targetPts);
 
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderReadVideoFrame")]
-    [return: MarshalAs(UnmanagedType.Bool)]
-    internal static partial bool VideoReaderReadVideoFrame(nint reader, Span<byte> frameBuffer, in double targetPts,
+    internal static partial VideoFrameStatus VideoReaderReadVideoFrame(nint reader, Span<byte> frameBuffer,
+        int bufferSize, in double targetPts, out double pts);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderReadVideoFrameWithStride")]
+    internal static partial VideoFrameStatus VideoReaderReadVideoFrameWithStride(nint reader, Span<byte> frameBuffer,
+        int bufferSize, int stride, in double targetPts, out double pts);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderPublishVideoFrame")]
+    internal static partial VideoFrameStatus VideoReaderPublishVideoFrame(nint reader, in double targetPts,
         out double pts);
 
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderAcquireFrame")]
+    [return: MarshalAs(UnmanagedType.Bool)]
+    internal static partial bool VideoReaderAcquireFrame(nint reader, out VideoFrame frame);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderReleaseFrame")]
+    internal static partial void VideoReaderReleaseFrame(nint reader, long generation);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetStreamCount")]
+    internal static partial int VideoReaderGetStreamCount(nint reader);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetStreamInfo")]
+    [return: MarshalAs(UnmanagedType.Bool)]
+    internal static partial bool VideoReaderGetStreamInfo(nint reader, int index, out MediaStreamInfo info);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderSelectStream")]
+    [return: MarshalAs(UnmanagedType.Bool)]
+    internal static partial bool VideoReaderSelectStream(nint reader, int index);
+
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderSeekVideoFrame")]
     [return: MarshalAs(UnmanagedType.Bool)]
     internal static partial bool VideoReaderSeekVideoFrame(nint reader, double targetPts);
 
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderSetOutputSize")]
+    internal static partial void VideoReaderSetOutputSize(nint reader, int width, int height, int scalerFlags);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderSetMaxFrameRate")]
+    internal static partial void VideoReaderSetMaxFrameRate(nint reader, int maxFrameRate);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderSyncAudioClock")]
+    internal static partial void VideoReaderSyncAudioClock(nint reader, double audioPts, double masterPts);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderPause")]
+    internal static partial void VideoReaderPause(nint reader);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderPlay")]
+    internal static partial void VideoReaderPlay(nint reader);
+
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderClose")]
     internal static partial void VideoReaderClose(nint reader);
 
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetPacketPoolStats")]
+    internal static partial void VideoReaderGetPacketPoolStats(nint reader, ref PacketPoolStats stats);
+
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetWidth")]
     internal static partial int VideoReaderGetWidth(nint reader);
 
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetHeight")]
     internal static partial int VideoReaderGetHeight(nint reader);
 
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetSourceWidth")]
+    internal static partial int VideoReaderGetSourceWidth(nint reader);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetSourceHeight")]
+    internal static partial int VideoReaderGetSourceHeight(nint reader);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetLowres")]
+    internal static partial int VideoReaderGetLowres(nint reader);
+
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetVideoFrameDelay")]
     internal static partial double VideoReaderGetVideoFrameDelay(nint reader);
 
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetSampleRate")]
     internal static partial int VideoReaderGetSampleRate(nint reader);
 
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetSampleFormat")]
+    internal static partial int VideoReaderGetSampleFormat(nint reader);
+
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderGetBitsPerSample")]
     internal static partial int VideoReaderGetBitsPerSample(nint reader);
 
@@ -133,4 +339,8 @@ public partial class VideoReader : IDisposable
     [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderSupportsAudio")]
     [return: MarshalAs(UnmanagedType.Bool)]
     internal static partial bool VideoReaderSupportsAudio(nint reader);
+
+    [LibraryImport("Simulacrum.AV.Core.dll", EntryPoint = "VideoReaderSupportsVideo")]
+    [return: MarshalAs(UnmanagedType.Bool)]
+    internal static partial bool VideoReaderSupportsVideo(nint reader);
 }
\ No newline at end of file
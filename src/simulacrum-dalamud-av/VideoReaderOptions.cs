@@ -0,0 +1,161 @@
+﻿using System.Runtime.InteropServices;
+
+namespace Simulacrum.AV;
+
+/// <summary>
+/// Options for opening a video. The default value selects the default behavior for every option.
+/// </summary>
+[StructLayout(LayoutKind.Sequential)]
+public struct VideoReaderOptions
+{
+    private int _pipelinedDecoding;
+
+    /// <summary>
+    /// Whether each stream should be decoded on a dedicated thread ahead of the reader.
+    /// </summary>
+    public bool PipelinedDecoding
+    {
+        readonly get => _pipelinedDecoding != 0;
+        set => _pipelinedDecoding = value ? 1 : 0;
+    }
+
+    /// <summary>
+    /// The number of decoded video frames to buffer in pipelined mode, or 0 for the default.
+    /// </summary>
+    public int VideoFrameQueueSize;
+
+    /// <summary>
+    /// The number of decoded audio frames to buffer in pipelined mode, or 0 for the default.
+    /// </summary>
+    public int AudioFrameQueueSize;
+
+    /// <summary>
+    /// The number of threads to decode video with, or 0 to size this automatically from the
+    /// number of cores and the number of active readers.
+    /// </summary>
+    public int DecoderThreadCount;
+
+    /// <summary>
+    /// The kind of multithreading to decode video with.
+    /// </summary>
+    public DecoderThreadType DecoderThreadType;
+
+    private int _disableCatchUpDecoding;
+
+    /// <summary>
+    /// Whether every frame on the way to a target timestamp should be fully decoded, rather than
+    /// skipping non-reference frames and the loop filter for frames that will never be shown.
+    /// </summary>
+    public bool DisableCatchUpDecoding
+    {
+        readonly get => _disableCatchUpDecoding != 0;
+        set => _disableCatchUpDecoding = value ? 1 : 0;
+    }
+
+    /// <summary>
+    /// The width to scale video frames to, or 0 for the source width. If only one of the output width
+    /// and height is set, the other is chosen to preserve the source aspect ratio.
+    /// </summary>
+    public int OutputWidth;
+
+    /// <summary>
+    /// The height to scale video frames to, or 0 for the source height.
+    /// </summary>
+    public int OutputHeight;
+
+    /// <summary>
+    /// The algorithm to scale video frames with.
+    /// </summary>
+    public ScalingAlgorithm ScalingAlgorithm;
+
+    private int _planarOutput;
+
+    /// <summary>
+    /// Whether <see cref="VideoReader.PublishVideoFrame"/> should publish decoded YUV420P and NV12 frames
+    /// as-is, so that they can be converted on the GPU. Frames in other formats are still converted to BGRA.
+    /// Frames published as-is keep their decoded size; the output size only applies to converted frames.
+    /// </summary>
+    public bool PlanarOutput
+    {
+        readonly get => _planarOutput != 0;
+        set => _planarOutput = value ? 1 : 0;
+    }
+
+    private int _disableSimdConversion;
+
+    /// <summary>
+    /// Whether video frames should always be converted with swscale, instead of using the built-in SIMD
+    /// color converters for unscaled YUV420P and NV12 frames.
+    /// </summary>
+    public bool DisableSimdConversion
+    {
+        readonly get => _disableSimdConversion != 0;
+        set => _disableSimdConversion = value ? 1 : 0;
+    }
+
+    /// <summary>
+    /// The number of threads to convert each video frame with, or 0 to size this automatically from the
+    /// number of cores and the number of active readers.
+    /// </summary>
+    public int ConversionThreadCount;
+
+    /// <summary>
+    /// The maximum number of new video frames to present per second, or 0 for no limit. Frames in between
+    /// are neither converted nor, where the codec allows it, fully decoded.
+    /// </summary>
+    public int MaxFrameRate;
+
+    /// <summary>
+    /// Decodes video at a reduced size of 1/2, 1/4 or 1/8 with a value of 1, 2 or 3, which is much cheaper
+    /// than decoding at full size and scaling down. This is limited to what the decoder supports; check
+    /// <see cref="VideoReader.Lowres"/> after opening to see what was applied.
+    /// </summary>
+    public int Lowres;
+
+    /// <summary>
+    /// The duration of resampled audio to decode ahead of <see cref="VideoReader.ReadAudioStream"/>, in
+    /// milliseconds, or 0 for the default. Reads larger than this are still filled completely.
+    /// </summary>
+    public int AudioBufferDuration;
+
+    /// <summary>
+    /// The sample format to output audio in.
+    /// </summary>
+    public AudioSampleFormat AudioSampleFormat;
+
+    /// <summary>
+    /// The sample rate to output audio at, or 0 for the source sample rate. Setting this to the rate of the
+    /// output device saves the system mixer from resampling the audio a second time.
+    /// </summary>
+    public int AudioSampleRate;
+
+    /// <summary>
+    /// The number of channels to output audio in, using the default layout for that many channels, or 0 for
+    /// stereo. Sources with a different layout are mixed down or up as needed.
+    /// </summary>
+    public int AudioChannelCount;
+
+    private int _disableAudio;
+
+    /// <summary>
+    /// Whether to open the video stream only, even if the file has audio. Audio packets are then discarded by
+    /// the demuxer, and no audio decoder or resampler is created. Files without audio are always opened this way.
+    /// </summary>
+    public bool DisableAudio
+    {
+        readonly get => _disableAudio != 0;
+        set => _disableAudio = value ? 1 : 0;
+    }
+
+    private int _disableVideo;
+
+    /// <summary>
+    /// Whether to open the audio stream only, even if the file has video. Video packets are then discarded by
+    /// the demuxer, and no video decoder or scaler is created. Files without video are always opened this way.
+    /// </summary>
+    public bool DisableVideo
+    {
+        readonly get => _disableVideo != 0;
+        set => _disableVideo = value ? 1 : 0;
+    }
+}
\ No newline at end of file
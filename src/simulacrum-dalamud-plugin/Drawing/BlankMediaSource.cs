@@ -15,6 +15,17 @@ public class BlankMediaSource : IMediaSource
         delay = TimeSpan.Zero;
     }
 
+    public bool RenderTo(Span<byte> buffer, int rowPitch, out TimeSpan delay)
+    {
+        RenderTo(buffer, out delay);
+        return true;
+    }
+
+    public bool HasNewFrame()
+    {
+        return true;
+    }
+
     public int PixelSize()
     {
         return 0;
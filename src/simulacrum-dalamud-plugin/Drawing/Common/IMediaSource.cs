@@ -15,6 +15,22 @@ public interface IMediaSource
     /// <param name="delay">The time the caller should wait before rendering again.</param>
     void RenderTo(Span<byte> buffer, out TimeSpan delay);
 
+    /// <summary>
+    /// Renders data into the provided frame buffer, whose rows may be padded. This is intended for
+    /// rendering directly into mapped textures.
+    /// </summary>
+    /// <param name="buffer">The buffer to render into.</param>
+    /// <param name="rowPitch">The distance between the starts of consecutive rows in the buffer, in bytes.</param>
+    /// <param name="delay">The time the caller should wait before rendering again.</param>
+    /// <returns>Whether any data was rendered into the buffer.</returns>
+    bool RenderTo(Span<byte> buffer, int rowPitch, out TimeSpan delay);
+
+    /// <summary>
+    /// Checks if the source has anything new to render since it was last rendered.
+    /// </summary>
+    /// <returns>Whether the source should be rendered again.</returns>
+    bool HasNewFrame();
+
     /// <summary>
     /// The pixel width of the input source.
     /// </summary>
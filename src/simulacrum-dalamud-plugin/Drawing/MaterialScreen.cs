@@ -14,9 +14,9 @@ public class MaterialScreen : IScreen, IDisposable
     private readonly Stopwatch _stopwatch;
     private readonly IPluginLog _log;
 
-    private byte[] _buffer;
     private Material? _material;
     private TextureBootstrap? _texture;
+    private TextureBootstrap? _renderedTexture;
     private IMediaSource? _source;
     private IntVector2 _size;
     private TimeSpan _delay;
@@ -27,8 +27,6 @@ public class MaterialScreen : IScreen, IDisposable
 
     public MaterialScreen(TextureFactory textureFactory, IUiBuilder ui, Location location, IPluginLog log)
     {
-        _buffer = Array.Empty<byte>();
-
         _log = log;
         _textureFactory = textureFactory;
         _ui = ui;
@@ -58,33 +56,33 @@ public class MaterialScreen : IScreen, IDisposable
         {
             _size = sourceSize;
 
-            var (sourceWidth, sourceHeight) = sourceSize;
-            var sourcePixelSize = _source.PixelSize(); // Not currently checking if this has changed
-            var bufferSize = sourceWidth * sourceHeight * sourcePixelSize;
-
-            _buffer = new byte[bufferSize];
-
-            // Initialize the screen with white (default is transparent) so we know it exists
-            for (var i = 0; i < _buffer.Length; i++)
-            {
-                _buffer[i] = 0xFF;
-            }
-
             // Rebuild the render surface; this doesn't need to happen immediately
+            var (sourceWidth, sourceHeight) = sourceSize;
             RebuildMaterial(sourceWidth, sourceHeight).FireAndForget(_log);
         }
 
-        _source.RenderTo(_buffer, out _delay);
+        // Uploading discards the texture's contents, so only skip it if the texture already holds this frame
+        if (_texture == _renderedTexture && !_source.HasNewFrame())
+        {
+            return;
+        }
+
         _stopwatch.Restart();
+        _renderedTexture = _texture;
 
+        // Render straight into the mapped texture, rather than staging each frame in a separate buffer
+        var source = _source;
         _texture?.Mutate((sub, desc) =>
         {
             unsafe
             {
-                var dst = (byte*)sub.PData;
-                var pitch = sub.RowPitch;
-                const int pixelSize = 4;
-                TextureUtils.CopyTexture2D(_buffer, dst, desc.Width, desc.Height, pixelSize, pitch);
+                var pitch = (int)sub.RowPitch;
+                var dst = new Span<byte>(sub.PData, pitch * (int)desc.Height);
+                if (!source.RenderTo(dst, pitch, out _delay))
+                {
+                    // Initialize the screen with white (default is transparent) so we know it exists
+                    dst.Fill(0xFF);
+                }
             }
         });
     }
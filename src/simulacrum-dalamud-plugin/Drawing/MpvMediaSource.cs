@@ -50,6 +50,16 @@ public class MpvMediaSource : IMediaSource, IDisposable
         throw new NotImplementedException();
     }
 
+    public bool RenderTo(Span<byte> buffer, int rowPitch, out TimeSpan delay)
+    {
+        throw new NotImplementedException();
+    }
+
+    public bool HasNewFrame()
+    {
+        return true;
+    }
+
     public int PixelSize()
     {
         return 4;
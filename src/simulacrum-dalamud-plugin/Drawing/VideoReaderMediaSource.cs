@@ -1,10 +1,10 @@
 ﻿using System.Buffers;
-using System.Runtime.InteropServices;
 using Dalamud.Plugin.Services;
 using NAudio.Wave;
 using R3;
 using Simulacrum.AV;
 using Simulacrum.Drawing.Common;
+using Simulacrum.Game;
 using Simulacrum.Monitoring;
 
 namespace Simulacrum.Drawing;
@@ -22,20 +22,19 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
         DebugMetrics.CreateHistogram("simulacrum_video_reader_audio_buffer_duration",
             "The audio chunk buffering duration (ms).");
 
-    private static readonly TimeSpan AudioSyncThreshold = TimeSpan.FromMilliseconds(100);
+    // Drift below this is smoothed out by the reader; anything beyond it is resynced immediately
+    private static readonly TimeSpan AudioSyncThreshold = TimeSpan.FromMilliseconds(500);
 
     private readonly VideoReader _reader;
 
-    private readonly nint _videoBufferPtr;
-    private readonly int _videoBufferRawSize;
-    private readonly int _videoBufferSize;
+    // This needs to be a dedicated thread or else playback can get choppy randomly. It is only set up
+    // if the source has video.
+    private readonly Thread? _videoThread;
 
-    // This needs to be a dedicated thread or else playback can get choppy randomly
-    private readonly Thread _videoThread;
-
-    private readonly BufferQueueWaveProvider _waveProvider;
-    private readonly IWavePlayer _wavePlayer; // TODO: Move this into the screen class for spatial audio
-    private readonly Thread _audioThread;
+    // These are only set up if the video has audio
+    private readonly BufferQueueWaveProvider? _waveProvider;
+    private readonly IWavePlayer? _wavePlayer; // TODO: Move this into the screen class for spatial audio
+    private readonly Thread? _audioThread;
 
     private readonly IReadOnlyPlaybackTracker _sync;
     private readonly IDisposable _unsubscribeAll;
@@ -43,11 +42,10 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
     private readonly IPluginLog _log;
 
     private TimeSpan _nextPts;
+    private long _renderedGeneration = -1;
     private bool _audioFlushRequested;
     private bool _done;
 
-    private unsafe Span<byte> VideoBuffer => new((byte*)_videoBufferPtr, _videoBufferRawSize);
-
     public VideoReaderMediaSource(string? uri, IReadOnlyPlaybackTracker sync, IPluginLog log)
     {
         _log = log;
@@ -55,44 +53,58 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
         ArgumentNullException.ThrowIfNull(uri);
 
         _reader = new VideoReader();
-        if (!_reader.Open(uri))
+
+        // Decode ahead of playback so that decoding spikes don't stall the render and audio loops
+        var options = new VideoReaderOptions { PipelinedDecoding = true };
+        if (!_reader.Open(uri, options))
         {
             throw new InvalidOperationException("Failed to open video.");
         }
 
         _sync = sync;
-        _videoBufferSize = _reader.Width * _reader.Height * PixelSize();
-
-        // For some reason, sws_scale writes 8 black pixels after the end of the buffer.
-        // If video playback randomly crashes, it's probably because this needs to be
-        // more specific.
-        _videoBufferRawSize = _videoBufferSize + 32;
-        _videoBufferPtr = Marshal.AllocHGlobal(_videoBufferRawSize);
-
-        _videoThread = new Thread(VideoLoop);
-        _videoThread.Start();
-
-        _waveProvider =
-            new BufferQueueWaveProvider(new WaveFormat(_reader.SampleRate, _reader.BitsPerSample,
-                _reader.AudioChannelCount));
-        _wavePlayer = new DirectSoundOut();
-        _wavePlayer.Init(_waveProvider);
-        _audioThread = new Thread(AudioLoop);
-        _audioThread.Start();
-
-        var unsubscribePause = _sync.OnPause().Subscribe(_wavePlayer, static (_, wp) => wp.Pause());
-        var unsubscribePlay = _sync.OnPlay().Subscribe(_wavePlayer, static (_, wp) => wp.Play());
+
+        if (_reader.SupportsVideo)
+        {
+            _videoThread = new Thread(VideoLoop);
+            _videoThread.Start();
+        }
+
+        if (_reader.SupportsAudio)
+        {
+            var waveFormat = _reader.SampleFormat == AudioSampleFormat.Float
+                ? WaveFormat.CreateIeeeFloatWaveFormat(_reader.SampleRate, _reader.AudioChannelCount)
+                : new WaveFormat(_reader.SampleRate, _reader.BitsPerSample, _reader.AudioChannelCount);
+            _waveProvider = new BufferQueueWaveProvider(waveFormat);
+            _wavePlayer = new DirectSoundOut();
+            _wavePlayer.Init(_waveProvider);
+            _audioThread = new Thread(AudioLoop);
+            _audioThread.Start();
+        }
+
+        var unsubscribePause = _sync.OnPause().Subscribe(this, static (_, ms) =>
+        {
+            ms._wavePlayer?.Pause();
+            ms._reader.Pause();
+        });
+        var unsubscribePlay = _sync.OnPlay().Subscribe(this, static (_, ms) =>
+        {
+            ms._reader.Play();
+            ms._wavePlayer?.Play();
+        });
         var unsubscribePan = _sync.OnPan().Subscribe(this, static (targetPts, ms) =>
         {
-            var audioDiff = targetPts - ms._waveProvider.PlaybackPosition;
-            if (audioDiff < TimeSpan.Zero || audioDiff > TimeSpan.FromSeconds(5))
+            if (ms._waveProvider is not null)
             {
-                if (!ms._reader.SeekAudioStream(targetPts.TotalSeconds))
+                var audioDiff = targetPts - ms._waveProvider.PlaybackPosition;
+                if (audioDiff < TimeSpan.Zero || audioDiff > TimeSpan.FromSeconds(5))
                 {
-                    ms._log.Warning("Failed to seek through audio stream");
-                }
+                    if (!ms._reader.SeekAudioStream(targetPts.TotalSeconds))
+                    {
+                        ms._log.Warning("Failed to seek through audio stream");
+                    }
 
-                ms._audioFlushRequested = true;
+                    ms._audioFlushRequested = true;
+                }
             }
 
             var videoDiff = targetPts - ms._nextPts;
@@ -112,7 +124,7 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
 
     public void RenderTo(Span<byte> buffer)
     {
-        VideoBuffer[.._videoBufferSize].CopyTo(buffer);
+        RenderTo(buffer, _reader.Width * PixelSize(), out _);
     }
 
     public void RenderTo(Span<byte> buffer, out TimeSpan delay)
@@ -121,8 +133,60 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
         delay = _reader.VideoFrameDelay;
     }
 
+    public bool RenderTo(Span<byte> buffer, int rowPitch, out TimeSpan delay)
+    {
+        delay = _reader.VideoFrameDelay;
+
+        // Copy the latest frame straight out of the reader's frame ring
+        if (!_reader.AcquireFrame(out var frame))
+        {
+            return false;
+        }
+
+        try
+        {
+            // The source may have switched resolution since the screen last sized its texture
+            var rowSize = frame.Width * PixelSize();
+            if (rowSize > rowPitch || buffer.Length < rowPitch * (frame.Height - 1) + rowSize)
+            {
+                return false;
+            }
+
+            unsafe
+            {
+                var src = new ReadOnlySpan<byte>((byte*)frame.Data[0], frame.Stride[0] * frame.Height);
+                TextureUtils.CopyTexture2D(src, frame.Stride[0], buffer, rowPitch, frame.Width * PixelSize(),
+                    frame.Height);
+            }
+        }
+        finally
+        {
+            _reader.ReleaseFrame(frame);
+        }
+
+        _renderedGeneration = frame.Generation;
+        return true;
+    }
+
+    public bool HasNewFrame()
+    {
+        if (!_reader.AcquireFrame(out var frame))
+        {
+            // Nothing has been published yet, so let the screen draw its placeholder
+            return true;
+        }
+
+        _reader.ReleaseFrame(frame);
+        return frame.Generation != _renderedGeneration;
+    }
+
     private void HandleAudioTick()
     {
+        if (_waveProvider is null || _wavePlayer is null)
+        {
+            return;
+        }
+
         if (_audioFlushRequested)
         {
             _waveProvider.Flush();
@@ -142,12 +206,17 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
             return;
         }
 
-        // Discard audio samples if the audio pts is ahead of the clock, and pad
-        // silence if the audio pts is behind the clock.
+        // Let the reader stretch or squeeze upcoming audio to follow the clock. If we're too far off
+        // for that, pad silence if the audio pts is ahead of the clock, and discard audio samples if
+        // the audio pts is behind the clock.
         var ts = _sync.GetTime();
         var pos = _waveProvider.PlaybackPosition;
         var audioDiff = pos - ts;
-        if (audioDiff > AudioSyncThreshold)
+        if (audioDiff.Duration() <= AudioSyncThreshold)
+        {
+            _reader.SyncAudioClock(pos.TotalSeconds, ts.TotalSeconds);
+        }
+        else if (audioDiff > AudioSyncThreshold)
         {
             // Pad samples with silence to delay playback slightly
             var nPadded = _waveProvider.PadSamples(audioDiff);
@@ -185,6 +254,11 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
 
     private int BufferAudio()
     {
+        if (_waveProvider is null)
+        {
+            return 0;
+        }
+
         if (_waveProvider.Count > AudioBufferQueueMaxItems)
         {
             // Ensure we don't have too many large buffers floating around at once
@@ -224,6 +298,11 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
 
     private void AudioLoop()
     {
+        if (_waveProvider is null)
+        {
+            return;
+        }
+
         while (!_done)
         {
             try
@@ -253,7 +332,7 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
         // no frames left to read.
         try
         {
-            if (!_reader.ReadVideoFrame(VideoBuffer, t.TotalSeconds, out _))
+            if (_reader.PublishVideoFrame(t.TotalSeconds, out _) == VideoFrameStatus.Error)
             {
                 // Don't trust the pts if we failed to read a frame.
                 return;
@@ -291,22 +370,23 @@ public class VideoReaderMediaSource : IMediaSource, IDisposable
 
     public IntVector2 Size()
     {
-        return IntVector2.Create(_reader.Width, _reader.Height);
+        // Audio-only sources still need a surface to draw their placeholder on
+        return _reader.SupportsVideo
+            ? IntVector2.Create(_reader.Width, _reader.Height)
+            : IntVector2.Create(1, 1);
     }
 
     public void Dispose()
     {
         _done = true;
-        _audioThread.Join();
-        _videoThread.Join();
+        _audioThread?.Join();
+        _videoThread?.Join();
 
         _unsubscribeAll.Dispose();
         _reader.Close();
         _reader.Dispose();
-        _wavePlayer.Dispose();
-        _waveProvider.Dispose();
-
-        Marshal.FreeHGlobal(_videoBufferPtr);
+        _wavePlayer?.Dispose();
+        _waveProvider?.Dispose();
         GC.SuppressFinalize(this);
     }
 }
\ No newline at end of file
@@ -83,4 +83,37 @@ public static class TextureUtils
             }
         }
     }
+
+    /// <summary>
+    /// Copies 2D texture data from a source to a destination, where the rows of both buffers may be
+    /// padded. Rows that don't fit in either buffer are skipped.
+    /// </summary>
+    /// <param name="src">The source buffer.</param>
+    /// <param name="srcPitch">The row pitch of the source buffer.</param>
+    /// <param name="dst">The destination buffer.</param>
+    /// <param name="dstPitch">The row pitch of the destination buffer.</param>
+    /// <param name="rowSize">The number of bytes to copy from each row.</param>
+    /// <param name="height">The number of rows to copy.</param>
+    public static void CopyTexture2D(
+        ReadOnlySpan<byte> src,
+        int srcPitch,
+        Span<byte> dst,
+        int dstPitch,
+        int rowSize,
+        int height)
+    {
+        rowSize = Math.Min(rowSize, Math.Min(srcPitch, dstPitch));
+        height = Math.Min(height, Math.Min(RowsThatFit(src.Length, srcPitch, rowSize),
+            RowsThatFit(dst.Length, dstPitch, rowSize)));
+        for (var i = 0; i < height; i++)
+        {
+            src.Slice(i * srcPitch, rowSize).CopyTo(dst.Slice(i * dstPitch, rowSize));
+        }
+    }
+
+    private static int RowsThatFit(int length, int pitch, int rowSize)
+    {
+        // The last row doesn't need any padding after it
+        return length < rowSize ? 0 : (length - rowSize) / pitch + 1;
+    }
 }
\ No newline at end of file
@@ -71,6 +71,8 @@ public class Simulacrum : IDalamudPlugin
         _config = (PluginConfiguration?)pluginInterface.GetPluginConfig() ?? new PluginConfiguration();
         _config.Initialize(pluginInterface);
 
+        VideoReader.SetKeyframeIndexDirectory(Path.Combine(pluginInterface.GetPluginConfigDirectory(), "keyframes"));
+
         _primitive = new PrimitiveDebug(sigScanner, gameInteropProvider, log);
 
         _hostctlBag = new DisposableBag();